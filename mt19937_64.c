@@ -56,25 +56,30 @@
 #ifndef MERSENNE_TWISTER
 #include <stdio.h>
 #endif
+#include "mt19937_64.h"
 
-#define NN 312
+#define NN MT19937_64_NN
 #define MM 156
 #define MATRIX_A 0xB5026F5AA96619E9ULL
 #define UM 0xFFFFFFFF80000000ULL /* Most significant 33 bits */
 #define LM 0x7FFFFFFFULL /* Least significant 31 bits */
 
 
-/* The array for the state vector */
-static unsigned long long mt[NN]; 
+/* The default state vector, one per thread */
 /* mti==NN+1 means mt[NN] is not initialized */
-static int mti=NN+1; 
+static __thread mt19937_64_t mt_default = MT19937_64_INITIALIZER;
 
 /* initializes mt[NN] with a seed */
+void init_genrand64_r(mt19937_64_t *state, unsigned long long seed)
+{
+    state->mt[0] = seed;
+    for (state->mti=1; state->mti<NN; state->mti++) 
+        state->mt[state->mti] =  (6364136223846793005ULL * (state->mt[state->mti-1] ^ (state->mt[state->mti-1] >> 62)) + state->mti);
+}
+
 void init_genrand64(unsigned long long seed)
 {
-    mt[0] = seed;
-    for (mti=1; mti<NN; mti++) 
-        mt[mti] =  (6364136223846793005ULL * (mt[mti-1] ^ (mt[mti-1] >> 62)) + mti);
+    init_genrand64_r(&mt_default, seed);
 }
 
 /* initialize by an array with array-length */
@@ -88,51 +93,51 @@ unsigned long long init_key[], key_length;
     i=1; j=0;
     k = (NN>key_length ? NN : key_length);
     for (; k; k--) {
-        mt[i] = (mt[i] ^ ((mt[i-1] ^ (mt[i-1] >> 62)) * 3935559000370003845ULL))
+        mt_default.mt[i] = (mt_default.mt[i] ^ ((mt_default.mt[i-1] ^ (mt_default.mt[i-1] >> 62)) * 3935559000370003845ULL))
           + init_key[j] + j; /* non linear */
         i++; j++;
-        if (i>=NN) { mt[0] = mt[NN-1]; i=1; }
+        if (i>=NN) { mt_default.mt[0] = mt_default.mt[NN-1]; i=1; }
         if (j>=key_length) j=0;
     }
     for (k=NN-1; k; k--) {
-        mt[i] = (mt[i] ^ ((mt[i-1] ^ (mt[i-1] >> 62)) * 2862933555777941757ULL))
+        mt_default.mt[i] = (mt_default.mt[i] ^ ((mt_default.mt[i-1] ^ (mt_default.mt[i-1] >> 62)) * 2862933555777941757ULL))
           - i; /* non linear */
         i++;
-        if (i>=NN) { mt[0] = mt[NN-1]; i=1; }
+        if (i>=NN) { mt_default.mt[0] = mt_default.mt[NN-1]; i=1; }
     }
 
-    mt[0] = 1ULL << 63; /* MSB is 1; assuring non-zero initial array */ 
+    mt_default.mt[0] = 1ULL << 63; /* MSB is 1; assuring non-zero initial array */ 
 }
 
 /* generates a random number on [0, 2^64-1]-interval */
-unsigned long long genrand64_int64(void)
+unsigned long long genrand64_int64_r(mt19937_64_t *state)
 {
     int i;
     unsigned long long x;
     static unsigned long long mag01[2]={0ULL, MATRIX_A};
 
-    if (mti >= NN) { /* generate NN words at one time */
+    if (state->mti >= NN) { /* generate NN words at one time */
 
         /* if init_genrand64() has not been called, */
         /* a default initial seed is used     */
-        if (mti == NN+1) 
-            init_genrand64(5489ULL); 
+        if (state->mti == NN+1) 
+            init_genrand64_r(state, 5489ULL); 
 
         for (i=0;i<NN-MM;i++) {
-            x = (mt[i]&UM)|(mt[i+1]&LM);
-            mt[i] = mt[i+MM] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
+            x = (state->mt[i]&UM)|(state->mt[i+1]&LM);
+            state->mt[i] = state->mt[i+MM] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
         }
         for (;i<NN-1;i++) {
-            x = (mt[i]&UM)|(mt[i+1]&LM);
-            mt[i] = mt[i+(MM-NN)] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
+            x = (state->mt[i]&UM)|(state->mt[i+1]&LM);
+            state->mt[i] = state->mt[i+(MM-NN)] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
         }
-        x = (mt[NN-1]&UM)|(mt[0]&LM);
-        mt[NN-1] = mt[MM-1] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
+        x = (state->mt[NN-1]&UM)|(state->mt[0]&LM);
+        state->mt[NN-1] = state->mt[MM-1] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
 
-        mti = 0;
+        state->mti = 0;
     }
   
-    x = mt[mti++];
+    x = state->mt[state->mti++];
 
     x ^= (x >> 29) & 0x5555555555555555ULL;
     x ^= (x << 17) & 0x71D67FFFEDA60000ULL;
@@ -142,6 +147,11 @@ unsigned long long genrand64_int64(void)
     return x;
 }
 
+unsigned long long genrand64_int64(void)
+{
+    return genrand64_int64_r(&mt_default);
+}
+
 /* generates a random number on [0, 2^63-1]-interval */
 long long genrand64_int63(void)
 {
@@ -1,8 +1,20 @@
 #ifndef _MT19937_64_
 #define _MT19937_64_
 
+#define MT19937_64_NN 312
+
+/* state vector, for use with the re-entrant (_r) functions */
+typedef struct {
+    unsigned long long mt[MT19937_64_NN];
+    int mti;
+} mt19937_64_t;
+
+/* an uninitialized state, seeded with the default seed on first use */
+#define MT19937_64_INITIALIZER { .mti = MT19937_64_NN + 1 }
+
 /* initializes mt[NN] with a seed */
 void init_genrand64(unsigned long long seed);
+void init_genrand64_r(mt19937_64_t *state, unsigned long long seed);
 
 /* initialize by an array with array-length */
 /* init_key is the array for initializing keys */
@@ -12,6 +24,7 @@ void init_by_array64(unsigned long long init_key[],
 
 /* generates a random number on [0, 2^64-1]-interval */
 unsigned long long genrand64_int64(void);
+unsigned long long genrand64_int64_r(mt19937_64_t *state);
 
 /* generates a random number on [0, 2^63-1]-interval */
 long long genrand64_int63(void);
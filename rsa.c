@@ -8,6 +8,7 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 #if RSA_MASTER
 #include "rsa_enc.h"
 #include "rsa_dec.h"
@@ -17,8 +18,11 @@
 
 #define OPTSTR_MAX_LEN 10
 #define RSA_KEYPATH "RSA_KEYPATH"
+#define RSA_BACKEND "RSA_BACKEND"
 #define MULTIPLE_ENTRIES_STR "the following keys have multiple entries\n"
 #define KEY_DISPLAY_DEFAULT "(d)"
+#define BACKEND_DISPLAY_CURRENT "(c)"
+#define BACKEND_DISPLAY_INDENT 4
 #define KEY_DISPLAY_WIDTH ((int)(KEY_DATA_MAX_LEN + \
 	strlen(" " KEY_DISPLAY_DEFAULT) + 1))
 
@@ -38,6 +42,10 @@ int rsa_encryption_level;
 int is_encryption_info_only;
 int file_size;
 int keep_orig_file;
+int is_keygen_f4;
+int keygen_threads = 1;
+int rsa_threads = 1;
+int rsa_batch = BLOCKS_PER_DATA_BUF;
 cipher_mode_t cipher_mode = CIPHER_MODE_ECB;
 
 static opt_t options_common[] = {
@@ -52,6 +60,13 @@ static opt_t options_common[] = {
 		"directory. the key directory can be set by the RSA_KEYPATH "
 		"environment variable. if it is not set, the current working "
 		"directory is assumed"},
+	{RSA_OPT_LIST_BACKENDS, 'L', "list-backends", no_argument, "list the "
+		"arithmetic backends. the one in use is marked by "
+		BACKEND_DISPLAY_CURRENT},
+	{RSA_OPT_BACKEND, 'B', "backend", required_argument, "use the "
+		"arithmetic backend " ARG ". the backend can be set by the "
+		"RSA_BACKEND environment variable. if it is not set, the "
+		"fastest backend supported by the cpu is used"},
 	{RSA_OPT_QUITE, 'q', "quite", no_argument, "set quite output"},
 	{RSA_OPT_VERBOSE, 'v', "verbose", no_argument, "set verbose output"},
 	{ RSA_OPT_MAX }
@@ -178,6 +193,16 @@ Exit:
 	return ret;
 }
 
+static int rsa_backend_set(char *name)
+{
+	if (number_backend_set(name)) {
+		rsa_error_message(RSA_ERR_BACKEND, name);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int parse_args_finalize(unsigned int *flags, rsa_handler_t *handler)
 {
 	int actions = 0;
@@ -190,6 +215,8 @@ static int parse_args_finalize(unsigned int *flags, rsa_handler_t *handler)
 		actions++;
 	if (*flags & OPT_FLAG(RSA_OPT_PATH))
 		actions++;
+	if (*flags & OPT_FLAG(RSA_OPT_LIST_BACKENDS))
+		actions++;
 
 	/* test for a single action option */
 	if (actions > 1) {
@@ -204,6 +231,7 @@ int parse_args(int argc, char *argv[], unsigned int *flags,
 	rsa_handler_t *handler)
 {
 	int opt, code;
+	char *backend;
 
 	optargs_init(handler->options);
 	while ((opt = getopt_long(argc, argv, optstring, longopts,
@@ -213,8 +241,14 @@ int parse_args(int argc, char *argv[], unsigned int *flags,
 		case RSA_OPT_HELP:
 		case RSA_OPT_KEY_SCAN:
 		case RSA_OPT_PATH:
+		case RSA_OPT_LIST_BACKENDS:
 			OPT_ADD(flags, code);
 			break;
+		case RSA_OPT_BACKEND:
+			OPT_ADD(flags, RSA_OPT_BACKEND);
+			if (rsa_backend_set(optarg))
+				return -1;
+			break;
 		case RSA_OPT_KEY_SET_DEFAULT:
 			OPT_ADD(flags, RSA_OPT_KEY_SET_DEFAULT);
 			if (optarg && rsa_set_key_name(optarg))
@@ -239,6 +273,12 @@ int parse_args(int argc, char *argv[], unsigned int *flags,
 		}
 	}
 
+	/* --backend overrides RSA_BACKEND */
+	if (!(*flags & OPT_FLAG(RSA_OPT_BACKEND)) &&
+		(backend = getenv(RSA_BACKEND)) && rsa_backend_set(backend)) {
+		return -1;
+	}
+
 	return parse_args_finalize(flags, handler);
 }
 
@@ -368,6 +408,46 @@ Error:
 	return -1;
 }
 
+static int rsa_threads_parse(int *threads, char *arg)
+{
+	char *err;
+
+	*threads = strtol(arg, &err, 10);
+	if (*err || *threads < 1 || *threads > RSA_THREADS_MAX) {
+		rsa_error_message(RSA_ERR_THREADS, arg, RSA_THREADS_MAX);
+		return -1;
+	}
+
+	return 0;
+}
+
+int rsa_keygen_threads_set(char *arg)
+{
+	return rsa_threads_parse(&keygen_threads, arg);
+}
+
+int rsa_threads_set(char *arg)
+{
+	return rsa_threads_parse(&rsa_threads, arg);
+}
+
+/* a data buffer holds a whole number of chunked cbc chunks, so that the chunks
+ * do not depend on the batch size a file is encrypted with */
+int rsa_batch_set(char *arg)
+{
+	char *err;
+
+	rsa_batch = strtol(arg, &err, 10);
+	if (*err || rsa_batch < 1 || rsa_batch > RSA_BATCH_MAX ||
+		rsa_batch % BLOCKS_PER_CHUNK) {
+		rsa_error_message(RSA_ERR_BATCH, arg, BLOCKS_PER_CHUNK,
+			RSA_BATCH_MAX);
+		return -1;
+	}
+
+	return 0;
+}
+
 static int rsa_key_size(void)
 {
 	int *level, accum = 0;
@@ -379,6 +459,18 @@ static int rsa_key_size(void)
 		3 * accum;
 }
 
+/* private keys may carry a crt key set per level following the rsa key sets:
+ * p, q, dp, dq, qinv, p and q montgomery factors */
+static int rsa_key_crt_size(void)
+{
+	int *level, accum = 0;
+
+	for (level = encryption_levels; *level; level++)
+		accum += number_size(*level);
+
+	return 7 * accum;
+}
+
 static rsa_key_t *rsa_key_alloc(char type, char *name, char *path, FILE *file)
 {
 	rsa_key_t *key;
@@ -448,15 +540,16 @@ static char *keydata_extract(FILE *f)
 {
 	static u1024_t data;
 	u1024_t scrambled_data, exp, n, montgomery_factor;
+	montgomery_ctx_t mont;
 
 	number_enclevl_set(encryption_levels[0]);
 	rsa_read_u1024_full(f, &scrambled_data);
 	rsa_read_u1024_full(f, &exp);
 	rsa_read_u1024_full(f, &n);
 	rsa_read_u1024_full(f, &montgomery_factor);
-	number_montgomery_factor_set(&n, &montgomery_factor);
+	number_montgomery_ctx_init(&mont, &n, &montgomery_factor);
 
-	rsa_decode(&data, &scrambled_data, &exp, &n);
+	rsa_decode(&data, &scrambled_data, &exp, &mont);
 	if (rsa_encryption_level)
 		number_enclevl_set(rsa_encryption_level);
 	return (char*)data.arr;
@@ -468,12 +561,14 @@ static rsa_key_t *rsa_key_open_gen(char *path, char accept, int is_expect_key)
 	char signiture[siglen], *data, keytype;
 	char *types[2] = { "private", "public" };
 	struct stat st;
+	rsa_key_t *key;
 	FILE *f;
 
 	if (stat(path, &st))
 		return NULL;
 
-	if (st.st_size != rsa_key_size()) {
+	if (st.st_size != rsa_key_size() &&
+		st.st_size != rsa_key_size() + rsa_key_crt_size()) {
 		if (is_expect_key)
 			rsa_error_message(RSA_ERR_KEY_CORRUPT, path);
 		return NULL;
@@ -502,7 +597,13 @@ static rsa_key_t *rsa_key_open_gen(char *path, char accept, int is_expect_key)
 		return NULL;
 	}
 
-	return rsa_key_alloc(keytype, data + 1, path, f);
+	if (!(key = rsa_key_alloc(keytype, data + 1, path, f))) {
+		fclose(f);
+		return NULL;
+	}
+
+	key->is_crt = st.st_size != rsa_key_size();
+	return key;
 }
 
 static rsa_key_t *rsa_key_open_try(char *path, char accept)
@@ -608,8 +709,7 @@ static rsa_key_t *rsa_key_open_dyn(char accept)
 			keyring->is_ambiguous[idx] = 0;
 			rsa_key_enclev_set(keyring->keys[idx],
 				encryption_levels[0]);
-			rsa_decode(&buf, &data, &keyring->keys[idx]->exp, 
-				&keyring->keys[idx]->n);
+			rsa_key_decode(keyring->keys[idx], &buf, &data);
 
 			/* exhaust the list of keys sprouting form the current
 			 * link in the keyring and see if any of them can
@@ -695,6 +795,30 @@ rsa_key_t *rsa_key_open(char accept)
 	return key;
 }
 
+static int rsa_key_crt_set(rsa_key_t *key, int new_level)
+{
+	int offset, *level;
+	crt_key_t *crt = &key->crt;
+
+	offset = rsa_key_size();
+	for (level = encryption_levels; *level && *level != new_level; level++)
+		offset += 7*number_size(*level);
+
+	if (!*level || fseek(key->file, offset, SEEK_SET)) {
+		rsa_error_message(RSA_ERR_INTERNAL, __FILE__, __FUNCTION__,
+			__LINE__);
+		return -1;
+	}
+
+	return rsa_read_u1024_full(key->file, &crt->p) ||
+		rsa_read_u1024_full(key->file, &crt->q) ||
+		rsa_read_u1024_full(key->file, &crt->dp) ||
+		rsa_read_u1024_full(key->file, &crt->dq) ||
+		rsa_read_u1024_full(key->file, &crt->qinv) ||
+		rsa_read_u1024_full(key->file, &crt->factor_p) ||
+		rsa_read_u1024_full(key->file, &crt->factor_q) ? -1 : 0;
+}
+
 int rsa_key_enclev_set(rsa_key_t *key, int new_level)
 {
 	int offset, *level, ret;
@@ -720,9 +844,14 @@ int rsa_key_enclev_set(rsa_key_t *key, int new_level)
 	ret = rsa_read_u1024_full(key->file, &key->exp) ||
 		rsa_read_u1024_full(key->file, &key->n) || 
 		rsa_read_u1024_full(key->file, &montgomery_factor) ? -1 : 0;
-	if (!ret)
-		number_montgomery_factor_set(&key->n, &montgomery_factor);
-	return ret;
+	if (ret)
+		return ret;
+
+	/* the key's montgomery context is set up once per level switch and
+	 * serves all of its exponentiations at that level */
+	number_montgomery_ctx_init(&key->mont, &key->n, &montgomery_factor);
+	number_barrett_ctx_init(&key->barrett, &key->n);
+	return key->is_crt ? rsa_key_crt_set(key, new_level) : 0;
 }
 
 static void keyname_display_init(char *key, int idx)
@@ -999,12 +1128,29 @@ static void rsa_show_path(void)
 		printf("%s/\n", key_path_get());
 }
 
+static void rsa_list_backends(void)
+{
+	char fmt[20], *name, *desc;
+	int i, is_supported;
+
+	sprintf(fmt, C_INDENTATION_FMT "\n", BACKEND_DISPLAY_INDENT);
+	for (i = 0; (name = number_backend_name(i, &desc, &is_supported));
+		i++) {
+		printf(" %s%s\n", strcmp(name, number_backend_get()) ? name :
+			rsa_highlight_str("%s %s", name,
+			BACKEND_DISPLAY_CURRENT), is_supported ? "" :
+			" (not supported by the cpu)");
+		printf(fmt, desc);
+	}
+}
+
 rsa_opt_t rsa_action_get(unsigned int flags, ...)
 {
 	va_list va;
 	rsa_opt_t new;
 	int actions = OPT_FLAG(RSA_OPT_HELP) | OPT_FLAG(RSA_OPT_KEY_SCAN) | 
-		OPT_FLAG(RSA_OPT_KEY_SET_DEFAULT) | OPT_FLAG(RSA_OPT_PATH);
+		OPT_FLAG(RSA_OPT_KEY_SET_DEFAULT) | OPT_FLAG(RSA_OPT_PATH) |
+		OPT_FLAG(RSA_OPT_LIST_BACKENDS);
 
 	va_start(va, flags);
 	while ((new = va_arg(va, rsa_opt_t)))
@@ -1014,10 +1160,12 @@ rsa_opt_t rsa_action_get(unsigned int flags, ...)
 	return flags & actions;
 }
 
-int rsa_action_handle_common(rsa_opt_t action, char *app, 
+int rsa_action_handle_common(rsa_opt_t action, char *app,
 	rsa_handler_t *handler)
 {
-	switch (action)
+	/* action is an option's flag, as returned by rsa_action_get(), which
+	 * need not be a value of rsa_opt_t */
+	switch ((int)action)
 	{
 	case OPT_FLAG(RSA_OPT_HELP):
 		rsa_help(app, handler->options);
@@ -1031,6 +1179,9 @@ int rsa_action_handle_common(rsa_opt_t action, char *app,
 	case OPT_FLAG(RSA_OPT_PATH):
 		rsa_show_path();
 		break;
+	case OPT_FLAG(RSA_OPT_LIST_BACKENDS):
+		rsa_list_backends();
+		break;
 	default:
 		return rsa_error(app);
 	}
@@ -1038,62 +1189,354 @@ int rsa_action_handle_common(rsa_opt_t action, char *app,
 	return 0;
 }
 
-static void rsa_zero_one(u1024_t *res, u1024_t *data)
+/* draws from the prng of ctx if given, otherwise from the thread's */
+static void rsa_zero_one(u1024_t *res, u1024_t *data, number_ctx_t *ctx)
 {
 	int i;
 
 	number_assign(*res, *data);
 	for (i = 0; i < block_sz_u1024; i++)
-		res->arr[i] ^= RSA_RANDOM();
+		res->arr[i] ^= ctx ? number_ctx_random(ctx) : RSA_RANDOM();
 	res->top = -1;
 }
 
-void rsa_encode(u1024_t *res, u1024_t *data, u1024_t *exp, u1024_t *n)
+/* r = data mod n, q = data / n, by barrett division if a context of n is
+ * given. returns 1 if data is to be encoded by rsa_zero_one() */
+static int rsa_encode_reduce(u1024_t *r, u64 *q, u1024_t *data,
+	montgomery_ctx_t *mont, barrett_ctx_t *barrett)
 {
-	u64 q;
-	u1024_t r;
+	u1024_t *n = &mont->n;
 
 	if (number_is_greater_or_equal(data, n)) {
 		u1024_t num_q;
 
-		number_dev(&num_q, &r, data, n);
-		q = *(u64*)&num_q;
+		if (barrett)
+			number_barrett_dev(&num_q, r, data, barrett);
+		else
+			number_dev(&num_q, r, data, n);
+		*q = *(u64*)&num_q;
 	}
 	else {
-		number_assign(r, *data);
-		q = (u64)0;
-	}
-
-	if (number_is_equal(&r, &NUM_0) || number_is_equal(&r, &NUM_1)) {
-		rsa_zero_one(res, data);
-		return;
+		number_assign(*r, *data);
+		*q = (u64)0;
 	}
 
-	number_modular_exponentiation_montgomery(res, &r, exp, n);
-	res->arr[block_sz_u1024] = q;
+	return number_is_equal(r, &NUM_0) || number_is_equal(r, &NUM_1);
 }
 
-void rsa_decode(u1024_t *res, u1024_t *data, u1024_t *exp, u1024_t *n)
+/* returns 1, leaving res untouched, if data is to be encoded by
+ * rsa_zero_one(). rsa_zero_one() draws from the prng, so blocks coded in
+ * parallel have it applied by the calling thread, in order */
+static int rsa_encode_common(u1024_t *res, u1024_t *data, u1024_t *exp,
+	montgomery_ctx_t *mont, barrett_ctx_t *barrett)
 {
 	u64 q;
 	u1024_t r;
 
-	if (data->top == -1) {
-		rsa_zero_one(res, data);
+	if (rsa_encode_reduce(&r, &q, data, mont, barrett))
+		return 1;
+
+	number_montgomery_exponentiation(res, &r, exp, mont);
+	res->arr[block_sz_u1024] = q;
+	return 0;
+}
+
+void rsa_encode(u1024_t *res, u1024_t *data, u1024_t *exp,
+	montgomery_ctx_t *mont)
+{
+	if (rsa_encode_common(res, data, exp, mont, NULL))
+		rsa_zero_one(res, data, NULL);
+}
+
+void rsa_key_encode(rsa_key_t *key, u1024_t *res, u1024_t *data)
+{
+	rsa_key_encode_ctx(key, NULL, res, data);
+}
+
+/* res = res + q*n, q being the quotient rsa_encode_reduce() kept */
+static void rsa_decode_quotient(u1024_t *res, u64 q, montgomery_ctx_t *mont)
+{
+	u1024_t num_q;
+
+	if (!q)
 		return;
-	}
+
+	number_small_dec2num(&num_q, q);
+	number_mul(&num_q, &num_q, &mont->n);
+	number_add(res, res, &num_q);
+}
+
+/* data->top == -1 marks a block encoded by rsa_zero_one(), see
+ * rsa_encode_common() */
+static void rsa_decode_common(u1024_t *res, u1024_t *data, u1024_t *exp,
+	montgomery_ctx_t *mont, crt_key_t *crt)
+{
+	u64 q;
+	u1024_t r;
 
 	q = data->arr[block_sz_u1024];
 	number_assign(r, *data);
 	r.arr[block_sz_u1024] = 0;
-	number_modular_exponentiation_montgomery(res, &r, exp, n);
+	if (crt)
+		number_modular_exponentiation_crt(res, &r, crt);
+	else
+		number_montgomery_exponentiation(res, &r, exp, mont);
+	rsa_decode_quotient(res, q, mont);
+}
 
-	if (q) {
-		u1024_t num_q;
+void rsa_decode(u1024_t *res, u1024_t *data, u1024_t *exp,
+	montgomery_ctx_t *mont)
+{
+	if (data->top == -1)
+		rsa_zero_one(res, data, NULL);
+	else
+		rsa_decode_common(res, data, exp, mont, NULL);
+}
 
-		number_small_dec2num(&num_q, q);
-		number_mul(&num_q, &num_q, n);
-		number_add(res, res, &num_q);
+/* private keys carrying a crt key set for the current level are decoded using
+ * the chinese remainder theorem */
+static crt_key_t *rsa_key_crt(rsa_key_t *key)
+{
+	return key->is_crt && !number_is_equal(&key->crt.p, &NUM_0) ?
+		&key->crt : NULL;
+}
+
+void rsa_key_decode(rsa_key_t *key, u1024_t *res, u1024_t *data)
+{
+	rsa_key_decode_ctx(key, NULL, res, data);
+}
+
+/* rsa_key_encode() and rsa_key_decode() drawing from the prng of ctx. ctx is
+ * at the current encryption level */
+void rsa_key_encode_ctx(rsa_key_t *key, number_ctx_t *ctx, u1024_t *res,
+	u1024_t *data)
+{
+	if (rsa_encode_common(res, data, &key->exp, &key->mont,
+		&key->barrett)) {
+		rsa_zero_one(res, data, ctx);
 	}
 }
 
+void rsa_key_decode_ctx(rsa_key_t *key, number_ctx_t *ctx, u1024_t *res,
+	u1024_t *data)
+{
+	if (data->top == -1) {
+		rsa_zero_one(res, data, ctx);
+	}
+	else {
+		rsa_decode_common(res, data, &key->exp, &key->mont,
+			rsa_key_crt(key));
+	}
+}
+
+typedef struct {
+	rsa_key_t *key;
+	crt_key_t *crt;
+	u1024_t *blocks;
+	int num;
+} rsa_blocks_t;
+
+/* blocks are coded NUMBER_LANES at a time, a job index per batch. they share
+ * the key's exponent, so their exponentiations are batched */
+#define RSA_BLOCKS_BATCHES(num) (((num) + NUMBER_LANES - 1) / NUMBER_LANES)
+
+/* zero/one blocks are left to the calling thread, marked with top == -1 */
+static void rsa_block_encode(void *arg, int idx)
+{
+	rsa_blocks_t *blks = (rsa_blocks_t*)arg;
+	u1024_t r[NUMBER_LANES], *r_ptr[NUMBER_LANES], *res[NUMBER_LANES];
+	u64 q[NUMBER_LANES];
+	int i, num = 0;
+
+	for (i = idx * NUMBER_LANES; i < blks->num &&
+		i < (idx + 1) * NUMBER_LANES; i++) {
+		u1024_t *blk = &blks->blocks[i];
+
+		if (rsa_encode_reduce(&r[num], &q[num], blk,
+			&blks->key->mont, &blks->key->barrett)) {
+			blk->top = -1;
+			continue;
+		}
+		r_ptr[num] = &r[num];
+		res[num++] = blk;
+	}
+
+	number_montgomery_exponentiation_batch(res, r_ptr, num,
+		&blks->key->exp, &blks->key->mont);
+	for (i = 0; i < num; i++)
+		res[i]->arr[block_sz_u1024] = q[i];
+}
+
+static void rsa_block_decode(void *arg, int idx)
+{
+	rsa_blocks_t *blks = (rsa_blocks_t*)arg;
+	u1024_t *res[NUMBER_LANES];
+	u64 q[NUMBER_LANES];
+	int i, num = 0;
+
+	for (i = idx * NUMBER_LANES; i < blks->num &&
+		i < (idx + 1) * NUMBER_LANES; i++) {
+		u1024_t *blk = &blks->blocks[i];
+
+		if (blk->top == -1)
+			continue;
+
+		q[num] = blk->arr[block_sz_u1024];
+		blk->arr[block_sz_u1024] = 0;
+		res[num++] = blk;
+	}
+
+	if (blks->crt) {
+		number_modular_exponentiation_crt_batch(res, res, num,
+			blks->crt);
+	}
+	else {
+		number_montgomery_exponentiation_batch(res, res, num,
+			&blks->key->exp, &blks->key->mont);
+	}
+	for (i = 0; i < num; i++)
+		rsa_decode_quotient(res[i], q[i], &blks->key->mont);
+}
+
+/* the zero/one blocks, coded by rsa_zero_one() in order */
+static void rsa_blocks_zero_one(u1024_t *blocks, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		if (blocks[i].top == -1)
+			rsa_zero_one(&blocks[i], &blocks[i], NULL);
+	}
+}
+
+/* encode num independent blocks in place, as rsa_key_encode() would one
+ * after the other */
+void rsa_key_encode_blocks(rsa_pool_t *pool, rsa_key_t *key, u1024_t *blocks,
+	int num)
+{
+	rsa_blocks_t blks = { .key = key, .blocks = blocks, .num = num };
+
+	rsa_pool_run(pool, rsa_block_encode, &blks, RSA_BLOCKS_BATCHES(num));
+	rsa_blocks_zero_one(blocks, num);
+}
+
+void rsa_key_decode_blocks(rsa_pool_t *pool, rsa_key_t *key, u1024_t *blocks,
+	int num)
+{
+	rsa_blocks_t blks = { .key = key, .crt = rsa_key_crt(key),
+		.blocks = blocks, .num = num };
+
+	rsa_pool_run(pool, rsa_block_decode, &blks, RSA_BLOCKS_BATCHES(num));
+	rsa_blocks_zero_one(blocks, num);
+}
+
+typedef struct {
+	FILE *in;
+	FILE *out;
+	int buf_len;
+} rsa_quick_t;
+
+static void rsa_quick_read(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_quick_t *quick = (rsa_quick_t*)arg;
+
+	buf->len = fread(buf->data, sizeof(char), quick->buf_len, quick->in);
+	buf->is_last = buf->len != quick->buf_len;
+}
+
+static void rsa_quick_xor(void *arg, rsa_pipe_buf_t *buf)
+{
+	u64 *xor_buf = (u64*)buf->data;
+	int i;
+
+	for (i = 0; buf->len && i < (buf->len-1)/sizeof(u64) + 1; i++)
+		xor_buf[i] ^= RSA_RANDOM();
+}
+
+static void rsa_quick_write(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_quick_t *quick = (rsa_quick_t*)arg;
+
+	fwrite(buf->data, sizeof(char), buf->len, quick->out);
+	rsa_timeline_update();
+}
+
+/* quick encryption and decryption alike xor the data with the prng's
+ * sequence */
+int rsa_crypt_quick(FILE *in, FILE *out)
+{
+	rsa_quick_t quick = {
+		.in = in,
+		.out = out,
+		.buf_len = sizeof(u64) * BUF_LEN_UNIT_QUICK,
+	};
+	int ret;
+
+	rsa_timeline_init(file_size, quick.buf_len);
+	ret = rsa_pipe_run(rsa_quick_read, rsa_quick_xor, rsa_quick_write,
+		&quick, quick.buf_len);
+	rsa_timeline_uninit();
+	return ret;
+}
+
+/* the chunks' prngs are independent only with MERSENNE_TWISTER. random(3) is
+ * process wide, in which case the chunks are chained one after the other */
+rsa_pool_t *rsa_chunks_pool_create(int threads)
+{
+#ifdef MERSENNE_TWISTER
+	return rsa_pool_create(threads);
+#else
+	return NULL;
+#endif
+}
+
+/* allocate the chunks of a data buffer of the given number of blocks */
+int rsa_chunks_alloc(rsa_chunks_t *chunks, int blocks)
+{
+	int chunks_num = (blocks + BLOCKS_PER_CHUNK - 1) / BLOCKS_PER_CHUNK;
+
+	chunks->ctx = rsa_buf_get(chunks_num * sizeof(number_ctx_t));
+	chunks->iv = rsa_buf_get(chunks_num * sizeof(u1024_t));
+	if (!chunks->ctx || !chunks->iv) {
+		rsa_chunks_free(chunks);
+		return -1;
+	}
+
+	return 0;
+}
+
+void rsa_chunks_free(rsa_chunks_t *chunks)
+{
+	rsa_buf_put(chunks->ctx);
+	rsa_buf_put(chunks->iv);
+	chunks->ctx = NULL;
+	chunks->iv = NULL;
+}
+
+/* set up the chunks of num blocks. the chunks' prngs are seeded, and their ivs
+ * drawn, in chunk order from the thread's prng. returns the number of chunks
+ * or -1 on error */
+int rsa_chunks_init(rsa_chunks_t *chunks, rsa_key_t *key, u1024_t *blocks,
+	int num)
+{
+	int i, chunks_num = (num + BLOCKS_PER_CHUNK - 1) / BLOCKS_PER_CHUNK;
+
+	chunks->key = key;
+	chunks->blocks = blocks;
+	chunks->blocks_num = num;
+	for (i = 0; i < chunks_num; i++) {
+		prng_seed_t seed = (prng_seed_t)RSA_RANDOM();
+
+		/* a 0 seed has the prng seeded from the time of day */
+		if (!seed)
+			seed = 1;
+		if (number_ctx_init(&chunks->ctx[i], encryption_level) ||
+			number_ctx_seed_set(&chunks->ctx[i], seed) ||
+			number_ctx_init_random(&chunks->ctx[i], &chunks->iv[i],
+			block_sz_u1024)) {
+			return -1;
+		}
+	}
+
+	return chunks_num;
+}
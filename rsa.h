@@ -8,6 +8,7 @@
 #define RSA_SIGNITURE "IASRSA"
 #define RSA_KEYLINK_PREFIX "key"
 #define RSA_ENCRYPTION_LEVEL_DEFAULT 128
+#define RSA_BATCH_MAX 4096
 #define RSA_KEY_TYPE_PRIVATE 1<<0
 #define RSA_KEY_TYPE_PUBLIC 1<<1
 
@@ -16,9 +17,14 @@
 #define RSA_DESCRIPTOR_CIPHER_MODE 0xc0
 #define RSA_DESCRIPTOR_CIPHER_MODE_ECB 0x00
 #define RSA_DESCRIPTOR_CIPHER_MODE_CBC 0x40
+#define RSA_DESCRIPTOR_CIPHER_MODE_CBC_CHUNKED 0x80
 
 #define BUF_LEN_UNIT_QUICK 1024
+/* default number of blocks per data buffer (see rsa_batch) */
 #define BLOCKS_PER_DATA_BUF 128
+/* chunked cbc: blocks per independently chained chunk. a data buffer holds a
+ * whole number of chunks */
+#define BLOCKS_PER_CHUNK 8
 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 
@@ -40,6 +46,7 @@ typedef enum {
 	RSA_OPT_KEY_SET_DEFAULT,
 	RSA_OPT_KEY_SET_DYNAMIC,
 	RSA_OPT_PATH,
+	RSA_OPT_LIST_BACKENDS,
 	RSA_OPT_QUITE,
 	RSA_OPT_VERBOSE,
 	RSA_OPT_ENCRYPT,
@@ -49,15 +56,22 @@ typedef enum {
 	RSA_OPT_LEVEL,
 	RSA_OPT_RSAENC,
 	RSA_OPT_CBC,
+	RSA_OPT_CBC_CHUNKED,
 	RSA_OPT_FILE,
 	RSA_OPT_ENC_INFO_ONLY,
 	RSA_OPT_ORIG_FILE,
+	RSA_OPT_KEYGEN_F4,
+	RSA_OPT_KEYGEN_THREADS,
+	RSA_OPT_THREADS,
+	RSA_OPT_BATCH,
+	RSA_OPT_BACKEND,
 	RSA_OPT_MAX
 } rsa_opt_t;
 
 typedef enum {
 	CIPHER_MODE_ECB,
 	CIPHER_MODE_CBC,
+	CIPHER_MODE_CBC_CHUNKED,
 } cipher_mode_t;
 
 typedef struct opt_t {
@@ -83,8 +97,22 @@ typedef struct rsa_key_t {
 	FILE *file;
 	u1024_t n;
 	u1024_t exp;
+	montgomery_ctx_t mont; /* of n at the current encryption level */
+	barrett_ctx_t barrett; /* likewise, reduces the blocks to encode */
+	int is_crt;
+	crt_key_t crt;
 } rsa_key_t;
 
+/* the chunks of a data buffer in chunked cbc mode. each chunk is chained on
+ * its own, starting with iv, and draws from the prng of its ctx */
+typedef struct {
+	rsa_key_t *key;
+	u1024_t *blocks;
+	int blocks_num;
+	number_ctx_t *ctx;
+	u1024_t *iv;
+} rsa_chunks_t;
+
 extern char key_data[KEY_DATA_MAX_LEN];
 extern char file_name[MAX_FILE_NAME_LEN];
 extern char newfile_name[MAX_FILE_NAME_LEN + 4];
@@ -92,6 +120,10 @@ extern int rsa_encryption_level;
 extern int is_encryption_info_only;
 extern int file_size;
 extern int keep_orig_file;
+extern int is_keygen_f4;
+extern int keygen_threads;
+extern int rsa_threads;
+extern int rsa_batch;
 extern cipher_mode_t cipher_mode;
 
 int opt_short2code(opt_t *options, int opt);
@@ -109,7 +141,28 @@ rsa_key_t *rsa_key_open(char accept);
 void rsa_key_close(rsa_key_t *key);
 int rsa_key_enclev_set(rsa_key_t *key, int new_level);
 int rsa_encryption_level_set(char *optarg);
-void rsa_encode(u1024_t *res, u1024_t *data, u1024_t *exp, u1024_t *n);
-void rsa_decode(u1024_t *res, u1024_t *data, u1024_t *exp, u1024_t *n);
+int rsa_keygen_threads_set(char *arg);
+int rsa_threads_set(char *arg);
+int rsa_batch_set(char *arg);
+void rsa_encode(u1024_t *res, u1024_t *data, u1024_t *exp,
+	montgomery_ctx_t *mont);
+void rsa_decode(u1024_t *res, u1024_t *data, u1024_t *exp,
+	montgomery_ctx_t *mont);
+void rsa_key_encode(rsa_key_t *key, u1024_t *res, u1024_t *data);
+void rsa_key_decode(rsa_key_t *key, u1024_t *res, u1024_t *data);
+void rsa_key_encode_ctx(rsa_key_t *key, number_ctx_t *ctx, u1024_t *res,
+	u1024_t *data);
+void rsa_key_decode_ctx(rsa_key_t *key, number_ctx_t *ctx, u1024_t *res,
+	u1024_t *data);
+int rsa_crypt_quick(FILE *in, FILE *out);
+rsa_pool_t *rsa_chunks_pool_create(int threads);
+int rsa_chunks_alloc(rsa_chunks_t *chunks, int blocks);
+void rsa_chunks_free(rsa_chunks_t *chunks);
+int rsa_chunks_init(rsa_chunks_t *chunks, rsa_key_t *key, u1024_t *blocks,
+	int num);
+void rsa_key_encode_blocks(rsa_pool_t *pool, rsa_key_t *key, u1024_t *blocks,
+	int num);
+void rsa_key_decode_blocks(rsa_pool_t *pool, rsa_key_t *key, u1024_t *blocks,
+	int num);
 #endif
 
@@ -4,11 +4,43 @@
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include "rsa.h"
 #include "mt19937_64.h"
 #include "rsa_util.h"
 #include "rsa_num.h"
 
+#define RSA_PUBLIC_EXPONENT_F4 65537
+
+/* a key set of a single encryption level */
+typedef struct {
+	int level;
+	u1024_t n;
+	u1024_t e;
+	u1024_t d;
+	crt_key_t crt;
+	/* threaded key generation */
+	u1024_t primes[2];
+	int primes_num; /* primes found so far */
+	int searchers; /* threads searching for the key set's primes */
+	int is_primes_found; /* cancels racing prime searches */
+	int is_done;
+} rsa_keyset_t;
+
+typedef struct {
+	rsa_keyset_t *keysets;
+	int keysets_num;
+	pthread_mutex_t lock;
+	unsigned long hits; /* sieve statistics of all threads */
+	unsigned long misses;
+} rsa_keygen_pool_t;
+
+typedef struct {
+	pthread_t thread;
+	rsa_keygen_pool_t *pool;
+	u1024_t seed;
+} rsa_keygen_worker_t;
+
 static int key_files_generate(char *private_name, FILE **private_key,
 	char *public_name, FILE **public_key, int len)
 {
@@ -63,7 +95,8 @@ static int key_files_generate(char *private_name, FILE **private_key,
 	return 0;
 }
 
-static int rsa_sign(FILE *key, char keytype, u1024_t *exp, u1024_t *n)
+static int rsa_sign(FILE *key, char keytype, u1024_t *exp,
+	montgomery_ctx_t *mont)
 {
 	u1024_t signiture, id;
 
@@ -71,7 +104,7 @@ static int rsa_sign(FILE *key, char keytype, u1024_t *exp, u1024_t *n)
 	if (number_str2num(&id, key_data))
 		return -1;
 
-	rsa_encode(&signiture, &id, exp, n);
+	rsa_encode(&signiture, &id, exp, mont);
 	if (rsa_write_str(key, RSA_SIGNITURE, strlen(RSA_SIGNITURE)) ||
 		rsa_write_u1024_full(key, &signiture)) {
 		return -1;
@@ -80,16 +113,27 @@ static int rsa_sign(FILE *key, char keytype, u1024_t *exp, u1024_t *n)
 	return 0;
 }
 
-static int insert_key(FILE *key, u1024_t *exp, u1024_t *n)
+static int insert_key(FILE *key, u1024_t *exp, montgomery_ctx_t *mont)
 {
 	u1024_t montgomery_factor;
 
-	number_montgomery_factor_set(n, NULL);
-	number_montgomery_factor_get(&montgomery_factor);
-	return rsa_write_u1024_full(key, exp) || rsa_write_u1024_full(key, n) ||
+	number_montgomery_ctx_factor_get(mont, &montgomery_factor);
+	return rsa_write_u1024_full(key, exp) ||
+		rsa_write_u1024_full(key, &mont->n) ||
 		rsa_write_u1024_full(key, &montgomery_factor);
 }
 
+static int insert_key_crt(FILE *key, crt_key_t *crt)
+{
+	return rsa_write_u1024_full(key, &crt->p) ||
+		rsa_write_u1024_full(key, &crt->q) ||
+		rsa_write_u1024_full(key, &crt->dp) ||
+		rsa_write_u1024_full(key, &crt->dq) ||
+		rsa_write_u1024_full(key, &crt->qinv) ||
+		rsa_write_u1024_full(key, &crt->factor_p) ||
+		rsa_write_u1024_full(key, &crt->factor_q);
+}
+
 /* rsa requires that the value of a given u1024, r, must be less than n to
  * qualify for encryption using n. if r is greater than n then upon decryption
  * of enc(r) what is calculated is r mod(n), which does not equal r.
@@ -116,85 +160,294 @@ static void rsa_infimum(u1024_t *inf)
 	inf->top = block_sz_u1024 - 1;
 }
 
-static void rsa_key_generator(u1024_t *n, u1024_t *e, u1024_t *d)
+/* with a fixed public exponent, e, primes p for which gcd(e, p-1) != 1 are
+ * rejected so that e is co prime with phi. F4 is prime, so gcd(e, p-1) == 1
+ * iff e does not divide p-1.
+ * returns -1 if the search has been cancelled (see number_find_prime_race()) */
+static int rsa_find_prime(u1024_t *p, int *cancel)
 {
-	u1024_t p1, p2, p1_sub1, p2_sub1, phi, inf, tmp;
-	int is_first = 1;
+	u1024_t e, p_sub1, r;
 
-	rsa_infimum(&inf);
+	number_small_dec2num(&e, (u64)RSA_PUBLIC_EXPONENT_F4);
 	do {
-		if (is_first)
-			is_first = 0;
-		else
-			rsa_error_message(RSA_ERR_KEYGEN);
+		if (number_find_prime_race(p, cancel))
+			return -1;
+		if (!is_keygen_f4)
+			return 0;
 
-		rsa_printf(1, 1, "finding first large prime: p1...");
-		number_find_prime(&p1);
-		rsa_printf(1, 1, "finding second large prime: p2...");
-		number_find_prime(&p2);
-		rsa_printf(1, 1, "calculating product: n=p1*p2...");
-		number_mul(n, &p1, &p2);
+		number_assign(p_sub1, *p);
+		number_sub1(&p_sub1);
+		number_mod(&r, &p_sub1, &e);
 	}
-	while (!number_is_greater_or_equal(n, &inf));
+	while (number_is_equal(&r, &NUM_0));
+
+	return 0;
+}
+
+/* generate the key set from the primes p1 and p2 at the key set's level.
+ * returns -1 if n = p1*p2 is too small, in which case new primes are
+ * required */
+static int rsa_key_generator_finalize(rsa_keyset_t *ks, u1024_t *p1,
+	u1024_t *p2)
+{
+	u1024_t p1_sub1, p2_sub1, phi, inf, tmp;
 
-	number_assign(p1_sub1, p1);
-	number_assign(p2_sub1, p2);
+	rsa_printf(1, 1, "calculating product: n=p1*p2...");
+	rsa_infimum(&inf);
+	number_mul(&ks->n, p1, p2);
+	if (!number_is_greater_or_equal(&ks->n, &inf))
+		return -1;
+
+	number_assign(p1_sub1, *p1);
+	number_assign(p2_sub1, *p2);
 	number_sub1(&p1_sub1);
 	number_sub1(&p2_sub1);
 	rsa_printf(1, 1, "calculating Euler phi function for n: "
 		"phi=(p1-1)*(p2-1)...");
 	number_mul(&phi, &p1_sub1, &p2_sub1);
 
-	rsa_printf(1, 1, "generating public key: (e, n), where e is co prime "
-		"with phi...");
-	number_init_random_coprime(e, &phi);
+	if (is_keygen_f4) {
+		number_small_dec2num(&ks->e, (u64)RSA_PUBLIC_EXPONENT_F4);
+	}
+	else {
+		rsa_printf(1, 1, "generating public key: (e, n), where e is co "
+			"prime with phi...");
+		number_init_random_coprime(&ks->e, &phi);
+	}
 	rsa_printf(1, 1, "calculating private key: (d, n), where d is the "
 		"multiplicative inverse of e modulo phi...");
-	number_modular_multiplicative_inverse(d, e, &phi);
+	number_modular_multiplicative_inverse(&ks->d, &ks->e, &phi);
 
 	/* e should be less than d */
-	if (number_is_greater(d, e))
-		return;
+	if (!number_is_greater(&ks->d, &ks->e)) {
+		number_assign(tmp, ks->e);
+		number_assign(ks->e, ks->d);
+		number_assign(ks->d, tmp);
+	}
 
-	number_assign(tmp, *e);
-	number_assign(*e, *d);
-	number_assign(*d, tmp);
+	rsa_printf(1, 1, "calculating chinese remainder theorem private key: "
+		"(p1, p2, d mod (p1-1), d mod (p2-1), p2^-1 mod p1)...");
+	number_crt_key_init(&ks->crt, p1, p2, &ks->d);
+	return 0;
+}
+
+static void rsa_key_generator(rsa_keyset_t *ks)
+{
+	u1024_t p1, p2;
+	unsigned long hits, misses, hits_prev, misses_prev;
+	int is_first = 1;
+
+	number_sieve_stats_get(&hits_prev, &misses_prev);
+	do {
+		if (is_first)
+			is_first = 0;
+		else
+			rsa_error_message(RSA_ERR_KEYGEN);
+
+		rsa_printf(1, 1, "finding first large prime: p1...");
+		rsa_find_prime(&p1, NULL);
+		rsa_printf(1, 1, "finding second large prime: p2...");
+		rsa_find_prime(&p2, NULL);
+		number_sieve_stats_get(&hits, &misses);
+		rsa_printf(1, 1, "prime candidates: %lu rejected by sieve, %lu "
+			"tested by miller-rabin", hits - hits_prev,
+			misses - misses_prev);
+	}
+	while (rsa_key_generator_finalize(ks, &p1, &p2));
+}
+
+/* the key set most in need of a prime search: the one with the fewest primes
+ * found or being searched for. larger levels, which take longer, are
+ * preferred. once all primes of a key set are being searched for, idle
+ * threads race on the key set's primes as well */
+static rsa_keyset_t *rsa_keygen_keyset_next(rsa_keygen_pool_t *pool)
+{
+	rsa_keyset_t *ks, *next = NULL;
+	int need, need_max = 0;
+
+	for (ks = pool->keysets; ks < pool->keysets + pool->keysets_num;
+		ks++) {
+		if (ks->is_done || ks->is_primes_found)
+			continue;
+
+		need = 2 - ks->primes_num - ks->searchers;
+		if (!next || need >= need_max) {
+			next = ks;
+			need_max = need;
+		}
+	}
+
+	return next;
+}
+
+static void *rsa_keygen_worker(void *arg)
+{
+	rsa_keygen_worker_t *worker = (rsa_keygen_worker_t*)arg;
+	rsa_keygen_pool_t *pool = worker->pool;
+	unsigned long hits, misses;
+	rsa_keyset_t *ks;
+	u1024_t p;
+	int ret;
+
+	/* each thread has a prng of its own */
+	number_seed_set_fixed(&worker->seed);
+
+	pthread_mutex_lock(&pool->lock);
+	while ((ks = rsa_keygen_keyset_next(pool))) {
+		ks->searchers++;
+		pthread_mutex_unlock(&pool->lock);
+
+		number_enclevl_set(ks->level);
+		ret = rsa_find_prime(&p, &ks->is_primes_found);
+
+		pthread_mutex_lock(&pool->lock);
+		ks->searchers--;
+
+		/* lost the race */
+		if (ret || ks->is_primes_found || (ks->primes_num &&
+			number_is_equal(&p, &ks->primes[0]))) {
+			continue;
+		}
+
+		number_assign(ks->primes[ks->primes_num], p);
+		if (++ks->primes_num < 2)
+			continue;
+
+		/* cancel the threads still racing on the key set's primes */
+		__atomic_store_n(&ks->is_primes_found, 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&pool->lock);
+
+		ret = rsa_key_generator_finalize(ks, &ks->primes[0],
+			&ks->primes[1]);
+
+		pthread_mutex_lock(&pool->lock);
+		if (ret) {
+			rsa_error_message(RSA_ERR_KEYGEN);
+			ks->primes_num = 0;
+			__atomic_store_n(&ks->is_primes_found, 0,
+				__ATOMIC_RELAXED);
+		}
+		else {
+			ks->is_done = 1;
+		}
+	}
+
+	number_sieve_stats_get(&hits, &misses);
+	pool->hits += hits;
+	pool->misses += misses;
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* generate all key sets concurrently using keygen_threads threads */
+static int rsa_keygen_threaded(rsa_keyset_t *keysets, int keysets_num)
+{
+	rsa_keygen_pool_t pool;
+	rsa_keygen_worker_t *workers;
+	int i, created, ret;
+
+	if (!(workers = calloc(keygen_threads, sizeof(rsa_keygen_worker_t))))
+		return -1;
+
+	memset(&pool, 0, sizeof(rsa_keygen_pool_t));
+	pool.keysets = keysets;
+	pool.keysets_num = keysets_num;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	rsa_printf(0, 0, "generating private and public keys: %d threads",
+		keygen_threads);
+	number_enclevl_set(encryption_levels[0]);
+	for (i = 0, created = 0; i < keygen_threads; i++) {
+		workers[i].pool = &pool;
+		if (number_init_random(&workers[i].seed, 1))
+			break;
+		if (pthread_create(&workers[i].thread, NULL, rsa_keygen_worker,
+			&workers[i])) {
+			break;
+		}
+		created++;
+	}
+
+	for (i = 0; i < created; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	if (created) {
+		rsa_printf(1, 1, "prime candidates: %lu rejected by sieve, %lu "
+			"tested by miller-rabin", pool.hits, pool.misses);
+	}
+
+	ret = created ? 0 : -1;
+	pthread_mutex_destroy(&pool.lock);
+	free(workers);
+	return ret;
 }
 
 int rsa_keygen(void)
 {
-	int ret, *level, is_first = 1;
+	int ret, *level, keysets_num, is_first = 1;
 	char private_name[MAX_FILE_NAME_LEN], public_name[MAX_FILE_NAME_LEN];
 	FILE *private_key, *public_key;
+	rsa_keyset_t *keysets, *ks;
+
+	for (level = encryption_levels; *level; level++);
+	keysets_num = level - encryption_levels;
+	if (!(keysets = calloc(keysets_num, sizeof(rsa_keyset_t))))
+		return -1;
+	for (ks = keysets, level = encryption_levels; *level; ks++, level++)
+		ks->level = *level;
 
 	if (key_files_generate(private_name, &private_key, public_name,
 		&public_key, MAX_FILE_NAME_LEN)) {
+		free(keysets);
 		return -1;
 	}
 
 	rsa_printf(0, 0, "generating key: %s (this will take a few minutes)",
 		rsa_highlight_str(key_data + 1));
-	for (level = encryption_levels; *level; level++) {
-		u1024_t n, e, d;
+	if (keygen_threads > 1) {
+		if (rsa_keygen_threaded(keysets, keysets_num)) {
+			ret = -1;
+			goto Exit;
+		}
+	}
+	else {
+		for (ks = keysets; ks < keysets + keysets_num; ks++) {
+			rsa_printf(0, 0, "generating private and public keys: "
+				"%d bits", ks->level);
+			number_enclevl_set(ks->level);
+			rsa_key_generator(ks);
+		}
+	}
 
-		rsa_printf(0, 0, "generating private and public keys: %d bits",
-			*level);
-		number_enclevl_set(*level);
-		rsa_key_generator(&n, &e, &d);
+	for (ks = keysets; ks < keysets + keysets_num; ks++) {
+		montgomery_ctx_t mont;
 
-		rsa_printf(1, 1, "writing %d bit keys...", *level);
+		number_enclevl_set(ks->level);
+		number_montgomery_ctx_init(&mont, &ks->n, NULL);
+
+		rsa_printf(1, 1, "writing %d bit keys...", ks->level);
 		if (is_first) {
-			if (rsa_sign(private_key, RSA_KEY_TYPE_PRIVATE, &e,
-				&n) || rsa_sign(public_key,
-				RSA_KEY_TYPE_PUBLIC, &d, &n)) {
+			if (rsa_sign(private_key, RSA_KEY_TYPE_PRIVATE, &ks->e,
+				&mont) || rsa_sign(public_key,
+				RSA_KEY_TYPE_PUBLIC, &ks->d, &mont)) {
 				ret = -1;
 				goto Exit;
 			}
 
 			is_first = 0;
 		}
-		if (insert_key(private_key, &d, &n) ||
-			insert_key(public_key, &e, &n)) {
+		if (insert_key(private_key, &ks->d, &mont) ||
+			insert_key(public_key, &ks->e, &mont)) {
+			ret = -1;
+			goto Exit;
+		}
+	}
+
+	/* crt key sets follow all rsa key sets in the private key */
+	for (ks = keysets; ks < keysets + keysets_num; ks++) {
+		number_enclevl_set(ks->level);
+		if (insert_key_crt(private_key, &ks->crt)) {
 			ret = -1;
 			goto Exit;
 		}
@@ -204,6 +457,7 @@ int rsa_keygen(void)
 Exit:
 	fclose(private_key);
 	fclose(public_key);
+	free(keysets);
 
 	if (ret) {
 		remove(private_name);
@@ -222,7 +476,8 @@ static void verbose_decryption(int is_full, char *key_name, int level,
 {
 	rsa_printf(!is_encryption_info_only, 0, "encryption method: %s (%s)",
 		is_full ? "full" : "quick", !is_full ? "rng" :
-		cipher_mode == CIPHER_MODE_CBC ? "cbc" : "ecb");
+		cipher_mode == CIPHER_MODE_CBC ? "cbc" :
+		cipher_mode == CIPHER_MODE_CBC_CHUNKED ? "chunked cbc" : "ecb");
 	rsa_printf(!is_encryption_info_only, 0, "key: %s", key_name);
 	rsa_printf(!is_encryption_info_only, 0, "encryption level: %d", level);
 	if (!is_encryption_info_only) {
@@ -240,7 +495,7 @@ static int rsa_decryption_length(rsa_key_t *key ,FILE *ciphertext)
 		rsa_read_u1024_full(ciphertext, &length)) {
 		return -1;
 	}
-	rsa_decode(&length, &length, &key->exp, &key->n);
+	rsa_key_decode(key, &length, &length);
 	return rsa_key_enclev_set(key, rsa_encryption_level) ?
 		-1 : (int)length.arr[0];
 }
@@ -257,7 +512,7 @@ static int rsa_decrypte_header_common(rsa_key_t *key, FILE *ciphertext,
 		return -1;
 	}
 
-	rsa_decode(&numdata, &numdata, &key->exp, &key->n);
+	rsa_key_decode(key, &numdata, &numdata);
 	descriptor = (char *)numdata.arr;
 
 	if (memcmp(key->name, descriptor + 1, strlen(key->name))) {
@@ -278,12 +533,15 @@ static int rsa_decrypte_header_common(rsa_key_t *key, FILE *ciphertext,
 	/* get encryption mode (full/quick) */
 	*is_full = (*descriptor & RSA_DESCRIPTOR_FULL_ENC) ? 1 : 0;
 
-	/* get cipher mode (ECB, CBC) */
+	/* get cipher mode (ECB, CBC, chunked CBC) */
 	switch (*descriptor & RSA_DESCRIPTOR_CIPHER_MODE)
 	{
 	case RSA_DESCRIPTOR_CIPHER_MODE_CBC:
 		cipher_mode = CIPHER_MODE_CBC;
 		break;
+	case RSA_DESCRIPTOR_CIPHER_MODE_CBC_CHUNKED:
+		cipher_mode = CIPHER_MODE_CBC_CHUNKED;
+		break;
 	case RSA_DESCRIPTOR_CIPHER_MODE_ECB:
 	default:
 		cipher_mode = CIPHER_MODE_ECB;
@@ -295,7 +553,7 @@ static int rsa_decrypte_header_common(rsa_key_t *key, FILE *ciphertext,
 		rsa_read_u1024_full(ciphertext, &seed)) {
 		return -1;
 	}
-	rsa_decode(&seed, &seed, &key->exp, &key->n);
+	rsa_key_decode(key, &seed, &seed);
 	if (number_seed_set_fixed(&seed))
 		return -1;
 
@@ -370,94 +628,177 @@ static void rsa_decrypt_epilog(rsa_key_t *key, FILE *plaintext,
 		remove(file_name);
 }
 
-static int rsa_decrypt_quick(rsa_key_t *key, FILE *ciphertext, FILE *plaintext)
+/* unchain the blocks of a chunk */
+static void rsa_decrypt_chunk(void *arg, int idx)
 {
-	int len, buf_len;
-
-	buf_len = sizeof(u64) * BUF_LEN_UNIT_QUICK;
-	rsa_timeline_init(file_size, buf_len);
-	do {
-		char buf[buf_len];
-		u64 *xor_buf = (u64*)buf;
-		int i;
-
-		len = fread(buf, sizeof(char), buf_len, ciphertext);
-		for (i = 0; len && i < (len-1)/sizeof(u64) + 1; i++)
-			xor_buf[i] ^= RSA_RANDOM();
-		fwrite(buf, sizeof(char), len, plaintext);
-		rsa_timeline_update();
+	rsa_chunks_t *chunks = (rsa_chunks_t*)arg;
+	u1024_t *iv = &chunks->iv[idx], tmp;
+	u1024_t *blk = chunks->blocks + idx * BLOCKS_PER_CHUNK;
+	int i, num = MIN(BLOCKS_PER_CHUNK,
+		chunks->blocks_num - idx * BLOCKS_PER_CHUNK);
+
+	for (i = 0; i < num; i++, blk++) {
+		number_assign(tmp, *blk);
+		tmp.arr[block_sz_u1024] = 0;
+		number_top_set(&tmp);
+		rsa_key_decode_ctx(chunks->key, &chunks->ctx[idx], blk, blk);
+		number_xor(blk, blk, iv);
+		number_assign(*iv, tmp);
 	}
-	while (len == buf_len);
-	rsa_timeline_uninit();
-	return 0;
 }
 
-static int rsa_decrypt_full(rsa_key_t *key, FILE *ciphertext, FILE *plaintext)
+/* full decryption state shared by the pipeline steps. a pipeline buffer holds
+ * up to rsa_batch blocks, read as level sized ciphertext and written as
+ * plaintext. they are decoded in blocks, the compute step's working set */
+typedef struct {
+	rsa_key_t *key;
+	FILE *ciphertext;
+	FILE *plaintext;
+	int pt_blk_sz;
+	int ct_blk_sz;
+	u1024_t *blocks;
+	int blocks_left; /* to read */
+	int len; /* plaintext written */
+	u1024_t num_iv;
+	u1024_t *iv_buf; /* cbc: the ciphertext of a buffer */
+	rsa_pool_t *pool;
+	rsa_chunks_t chunks;
+	int ret;
+} rsa_decrypt_t;
+
+static void rsa_decrypt_full_read(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_decrypt_t *dec = (rsa_decrypt_t*)arg;
+	int blocks;
+
+	/* read the blocks left to decrypt, up to a buffer's worth */
+	blocks = MIN(dec->blocks_left, rsa_batch);
+	buf->len = fread(buf->data, dec->ct_blk_sz, blocks, dec->ciphertext);
+	dec->blocks_left -= blocks;
+	buf->is_last = buf->len < blocks || !dec->blocks_left;
+}
+
+static void rsa_decrypt_full_compute(void *arg, rsa_pipe_buf_t *buf)
 {
-	int len, ct_buf_len, pt_blk_sz, ct_blk_sz;
-	u1024_t num_iv, tmp;
+	rsa_decrypt_t *dec = (rsa_decrypt_t*)arg;
+	u1024_t *ct_buf = dec->blocks;
+	char *data = (char*)buf->data;
+	int i, chunks_num;
 
-	/* determine plaintext block size and ciphertext buffer length */
-	pt_blk_sz = rsa_encryption_level/sizeof(u64);
-	ct_blk_sz = number_size(rsa_encryption_level);
-	ct_buf_len = BLOCKS_PER_DATA_BUF * ct_blk_sz;
-	len = 0;
+	for (i = 0; i < buf->len; i++)
+		number_unpack(&ct_buf[i], data + i * dec->ct_blk_sz);
 
-	/* cipher mode initialization */
 	switch (cipher_mode)
 	{
 	case CIPHER_MODE_CBC:
-		number_init_random(&num_iv, block_sz_u1024);
+		/* each ciphertext block is the iv of the following block */
+		for (i = 0; i < buf->len; i++) {
+			number_assign(dec->iv_buf[i], ct_buf[i]);
+			dec->iv_buf[i].arr[block_sz_u1024] = 0;
+			number_top_set(&dec->iv_buf[i]);
+		}
+
+		rsa_key_decode_blocks(dec->pool, dec->key, ct_buf, buf->len);
+
+		for (i = 0; i < buf->len; i++) {
+			number_xor(&ct_buf[i], &ct_buf[i],
+				i ? &dec->iv_buf[i - 1] : &dec->num_iv);
+		}
+		if (buf->len)
+			number_assign(dec->num_iv, dec->iv_buf[buf->len - 1]);
+		break;
+	case CIPHER_MODE_CBC_CHUNKED:
+		if ((chunks_num = rsa_chunks_init(&dec->chunks, dec->key,
+			ct_buf, buf->len)) < 0) {
+			dec->ret = -1;
+			break;
+		}
+		rsa_pool_run(dec->pool, rsa_decrypt_chunk, &dec->chunks,
+			chunks_num);
 		break;
 	case CIPHER_MODE_ECB:
 	default:
+		rsa_key_decode_blocks(dec->pool, dec->key, ct_buf, buf->len);
 		break;
 	}
 
-	rsa_timeline_init(file_size, block_sz_u1024*sizeof(u64));
-	do {
-		u1024_t ct_buf[ct_buf_len];
-		int i;
-
-		for (i = 0; i < ct_buf_len && len < file_size; i++) {
-			if (rsa_read_u1024_full(ciphertext, &ct_buf[i]))
-				break;
-
-			/* pre decrypting cipher mode handling */
-			switch (cipher_mode)
-			{
-			case CIPHER_MODE_CBC:
-				number_assign(tmp, ct_buf[i]);
-				break;
-			case CIPHER_MODE_ECB:
-			default:
-				break;
-			}
+	for (i = 0; i < buf->len; i++)
+		memcpy(data + i * dec->pt_blk_sz, ct_buf[i].arr, dec->pt_blk_sz);
+}
 
-			rsa_decode(&ct_buf[i], &ct_buf[i], &key->exp, &key->n);
-
-			/* post decrypting cipher mode handling */
-			switch (cipher_mode)
-			{
-			case CIPHER_MODE_CBC:
-				number_xor(&ct_buf[i], &ct_buf[i], &num_iv);
-				number_assign(num_iv, tmp);
-				num_iv.arr[block_sz_u1024] = 0;
-				number_top_set(&num_iv);
-				break;
-			case CIPHER_MODE_ECB:
-			default:
-				break;
-			}
+static void rsa_decrypt_full_write(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_decrypt_t *dec = (rsa_decrypt_t*)arg;
+	int i;
+
+	dec->len += fwrite(buf->data, sizeof(char),
+		MIN(buf->len * dec->pt_blk_sz, file_size - dec->len),
+		dec->plaintext);
+	for (i = 0; i < buf->len; i++)
+		rsa_timeline_update();
+}
+
+static int rsa_decrypt_full(rsa_key_t *key, FILE *ciphertext, FILE *plaintext)
+{
+	rsa_decrypt_t dec;
+
+	memset(&dec, 0, sizeof(rsa_decrypt_t));
+	dec.key = key;
+	dec.ciphertext = ciphertext;
+	dec.plaintext = plaintext;
+
+	/* determine plaintext and ciphertext block sizes and the number of
+	 * blocks */
+	dec.pt_blk_sz = rsa_encryption_level/sizeof(u64);
+	dec.ct_blk_sz = number_size(rsa_encryption_level);
+	dec.blocks_left = (file_size + dec.pt_blk_sz - 1) / dec.pt_blk_sz;
+	if (!(dec.blocks = rsa_buf_get(rsa_batch * sizeof(u1024_t)))) {
+		dec.ret = -1;
+		goto Exit;
+	}
 
-			len += fwrite(&ct_buf[i].arr, sizeof(char),
-				MIN(pt_blk_sz, file_size - len), plaintext);
-			rsa_timeline_update();
+	/* cipher mode initialization. ecb blocks are independent. cbc blocks
+	 * only depend on the previous ciphertext block, so they too are decoded
+	 * in parallel and xored with their predecessors afterwards. chunked
+	 * cbc chunks are independent */
+	switch (cipher_mode)
+	{
+	case CIPHER_MODE_CBC:
+		number_init_random(&dec.num_iv, block_sz_u1024);
+		if (!(dec.iv_buf = rsa_buf_get(rsa_batch * sizeof(u1024_t)))) {
+			dec.ret = -1;
+			goto Exit;
 		}
+		dec.pool = rsa_pool_create(rsa_threads);
+		break;
+	case CIPHER_MODE_CBC_CHUNKED:
+		if (rsa_chunks_alloc(&dec.chunks, rsa_batch)) {
+			dec.ret = -1;
+			goto Exit;
+		}
+		dec.pool = rsa_chunks_pool_create(rsa_threads);
+		break;
+	case CIPHER_MODE_ECB:
+	default:
+		dec.pool = rsa_pool_create(rsa_threads);
+		break;
+	}
+
+	/* read, decode and write buffers concurrently */
+	rsa_timeline_init(file_size, block_sz_u1024*sizeof(u64));
+	if (rsa_pipe_run(rsa_decrypt_full_read, rsa_decrypt_full_compute,
+		rsa_decrypt_full_write, &dec,
+		rsa_batch * dec.ct_blk_sz)) {
+		dec.ret = -1;
 	}
-	while (len < file_size);
 	rsa_timeline_uninit();
-	return 0;
+
+Exit:
+	rsa_pool_destroy(dec.pool);
+	rsa_chunks_free(&dec.chunks);
+	rsa_buf_put(dec.iv_buf);
+	rsa_buf_put(dec.blocks);
+	return dec.ret;
 }
 
 int rsa_decrypt(void)
@@ -471,7 +812,7 @@ int rsa_decrypt(void)
 
 	if (!is_encryption_info_only) {
 		ret = is_full ? rsa_decrypt_full(key, ciphertext, plaintext) :
-			rsa_decrypt_quick(key, ciphertext, plaintext);
+			rsa_crypt_quick(ciphertext, plaintext);
 	}
 
 	rsa_decrypt_epilog(key, plaintext, ciphertext);
@@ -10,8 +10,22 @@ static opt_t options_decrypter[] = {
 	{RSA_OPT_ORIG_FILE, 'o', "original", no_argument, "keep the original "
 		"file. if this option is not set the file will be deleted "
 		"after it has been decrypted"},
+	{RSA_OPT_THREADS, 't', "threads", required_argument, "decrypt a "
+		"full RSA encrypted file using " ARG " threads (default 1). "
+		"blocks are decoded in parallel in all cipher modes"},
+	{RSA_OPT_BATCH, 'b', "batch", required_argument, "decrypt a full "
+		"RSA encrypted file " ARG " blocks at a time (default 128). "
+		ARG " is a multiple of 8 up to 4096"},
 	{RSA_OPT_KEYGEN, 'g', "generate", required_argument, "generate an RSA "
 		"public/private key pair. " ARG " is its name"},
+	{RSA_OPT_KEYGEN_F4, 'F', "f4", no_argument, "use the fixed public "
+		"exponent 65537 (F4) when generating a key pair. public key "
+		"operations are considerably faster than with the default "
+		"random public exponent"},
+	{RSA_OPT_KEYGEN_THREADS, 'j', "jobs", required_argument, "generate "
+		"a key pair using " ARG " threads (default 1). the encryption "
+		"levels are generated concurrently and threads race on finding "
+		"their primes"},
 	{RSA_OPT_ENC_INFO_ONLY, 'i', "info", no_argument, "get info regarding "
 		"an encrypted file. this depends on possessing the required "
 		"private key"},
@@ -21,6 +35,20 @@ static opt_t options_decrypter[] = {
 /* either encryption or decryption task are to be performed */
 static int parse_args_finalize_decrypter(unsigned int *flags, int actions)
 {
+	/* RSA_OPT_KEYGEN_F4 requires RSA_OPT_KEYGEN */
+	if ((*flags & OPT_FLAG(RSA_OPT_KEYGEN_F4)) &&
+		!(*flags & OPT_FLAG(RSA_OPT_KEYGEN))) {
+		rsa_error_message(RSA_ERR_KEYGEN_F4);
+		return -1;
+	}
+
+	/* RSA_OPT_KEYGEN_THREADS requires RSA_OPT_KEYGEN */
+	if ((*flags & OPT_FLAG(RSA_OPT_KEYGEN_THREADS)) &&
+		!(*flags & OPT_FLAG(RSA_OPT_KEYGEN))) {
+		rsa_error_message(RSA_ERR_KEYGEN_THREADS);
+		return -1;
+	}
+
 	if (!actions && !(*flags & OPT_FLAG(RSA_OPT_KEYGEN)))
 		*flags |= OPT_FLAG(RSA_OPT_DECRYPT);
 
@@ -48,6 +76,15 @@ static int parse_args_decrypter(int opt, unsigned int *flags)
 		if (rsa_set_key_data(optarg))
 			return -1;
 		break;
+	case RSA_OPT_KEYGEN_F4:
+		OPT_ADD(flags, RSA_OPT_KEYGEN_F4);
+		is_keygen_f4 = 1;
+		break;
+	case RSA_OPT_KEYGEN_THREADS:
+		OPT_ADD(flags, RSA_OPT_KEYGEN_THREADS);
+		if (rsa_keygen_threads_set(optarg))
+			return -1;
+		break;
 	case RSA_OPT_ENC_INFO_ONLY:
 		OPT_ADD(flags, RSA_OPT_ENC_INFO_ONLY);
 		is_encryption_info_only = 1;
@@ -56,6 +93,16 @@ static int parse_args_decrypter(int opt, unsigned int *flags)
 		OPT_ADD(flags, RSA_OPT_ORIG_FILE);
 		keep_orig_file = 1;
 		break;
+	case RSA_OPT_THREADS:
+		OPT_ADD(flags, RSA_OPT_THREADS);
+		if (rsa_threads_set(optarg))
+			return -1;
+		break;
+	case RSA_OPT_BATCH:
+		OPT_ADD(flags, RSA_OPT_BATCH);
+		if (rsa_batch_set(optarg))
+			return -1;
+		break;
 	default:
 		rsa_error_message(RSA_ERR_OPTARG);
 		return -1;
@@ -15,7 +15,8 @@ static void verbose_encryption(int is_full, char *key_name, int level,
 	rsa_printf(1, 0, "encryption method: %s (%s)", is_full ?
 		"full" : "quick",
 		!is_full ? "rng" : cipher_mode == CIPHER_MODE_CBC ?
-		"cbc" : "ecb");
+		"cbc" : cipher_mode == CIPHER_MODE_CBC_CHUNKED ?
+		"chunked cbc" : "ecb");
 	rsa_printf(1, 0, "key: %s", key_name);
 	rsa_printf(1, 0, "encryption level: %d", level);
 	rsa_printf(1, 0, "encrypting: %s", plaintext);
@@ -31,7 +32,7 @@ static int rsa_encrypt_seed(rsa_key_t *key, FILE *ciphertext)
 		number_seed_set_random(&seed)) {
 		return -1;
 	}
-	rsa_encode(&seed, &seed, &key->exp, &key->n);
+	rsa_key_encode(key, &seed, &seed);
 	return rsa_write_u1024_full(ciphertext, &seed);
 }
 
@@ -43,7 +44,7 @@ static int rsa_encrypt_length(rsa_key_t *key, FILE *ciphertext)
 		return -1;
 
 	number_data2num(&length, &file_size, sizeof(file_size));
-	rsa_encode(&length, &length, &key->exp, &key->n);
+	rsa_key_encode(key, &length, &length);
 	if (rsa_write_u1024_full(ciphertext, &length))
 		return -1;
 
@@ -76,6 +77,9 @@ static int rsa_encrypt_header_common(rsa_key_t *key, FILE *ciphertext,
 	case CIPHER_MODE_CBC:
 		*descriptor |= RSA_DESCRIPTOR_CIPHER_MODE_CBC;
 		break;
+	case CIPHER_MODE_CBC_CHUNKED:
+		*descriptor |= RSA_DESCRIPTOR_CIPHER_MODE_CBC_CHUNKED;
+		break;
 	case CIPHER_MODE_ECB:
 	default:
 		*descriptor |= RSA_DESCRIPTOR_CIPHER_MODE_ECB;
@@ -85,7 +89,7 @@ static int rsa_encrypt_header_common(rsa_key_t *key, FILE *ciphertext,
 	if (number_data2num(&numdata, descriptor, KEY_DATA_MAX_LEN))
 		return -1;
 
-	rsa_encode(&numdata, &numdata, &key->exp, &key->n);
+	rsa_key_encode(key, &numdata, &numdata);
 	return rsa_write_u1024_full(ciphertext, &numdata) || 
 		rsa_encrypt_seed(key, ciphertext) || 
 		rsa_encrypt_length(key, ciphertext) ? -1 : 0;
@@ -181,108 +185,189 @@ static void rsa_encrypt_epilog(rsa_key_t *key, FILE *plaintext,
 		remove(file_name);
 }
 
+/* the original file is kept */
+static void rsa_encrypt_abort(rsa_key_t *key, FILE *plaintext,
+	FILE *ciphertext)
+{
+	rsa_key_close(key);
+	fclose(plaintext);
+	fclose(ciphertext);
+	remove(newfile_name);
+}
+
 int rsa_encrypt_quick(void)
 {
 	rsa_key_t *key;
 	FILE *plaintext, *ciphertext;
-	int len, buf_len;
 
 	if (rsa_encrypt_prolog(&key, &plaintext, &ciphertext, 0))
 		return -1;
 
 	/* quick encryption */
-	buf_len = sizeof(u64) * BUF_LEN_UNIT_QUICK;
-	rsa_timeline_init(file_size, buf_len);
-	do {
-		char buf[buf_len];
-		u64 *xor_buf = (u64*)buf;
-		int i;
-
-		len = fread(buf, sizeof(char), buf_len, plaintext);
-		for (i = 0; len && i < (len-1)/sizeof(u64) + 1; i++)
-			xor_buf[i] ^= RSA_RANDOM();
-		fwrite(buf, sizeof(char), len, ciphertext);
-		rsa_timeline_update();
+	if (rsa_crypt_quick(plaintext, ciphertext)) {
+		rsa_encrypt_abort(key, plaintext, ciphertext);
+		return -1;
 	}
-	while (len == buf_len);
-	rsa_timeline_uninit();
 
 	rsa_encrypt_epilog(key, plaintext, ciphertext);
 	return 0;
 }
 
-int rsa_encrypt_full(void)
+/* chain the blocks of a chunk */
+static void rsa_encrypt_chunk(void *arg, int idx)
 {
+	rsa_chunks_t *chunks = (rsa_chunks_t*)arg;
+	u1024_t *iv = &chunks->iv[idx];
+	u1024_t *blk = chunks->blocks + idx * BLOCKS_PER_CHUNK;
+	int i, num = MIN(BLOCKS_PER_CHUNK,
+		chunks->blocks_num - idx * BLOCKS_PER_CHUNK);
+
+	for (i = 0; i < num; i++, blk++) {
+		number_xor(blk, blk, iv);
+		rsa_key_encode_ctx(chunks->key, &chunks->ctx[idx], blk, blk);
+		number_assign(*iv, *blk);
+		iv->arr[block_sz_u1024] = 0;
+		number_top_set(iv);
+	}
+}
+
+/* full encryption state shared by the pipeline steps. a pipeline buffer holds
+ * up to rsa_batch blocks, read as plaintext and written as level sized
+ * ciphertext. they are coded in blocks, the compute step's working set */
+typedef struct {
 	rsa_key_t *key;
-	FILE *plaintext, *ciphertext;
-	int len, pt_buf_len, ct_buf_len, pt_blk_sz, ct_blk_sz;
+	FILE *plaintext;
+	FILE *ciphertext;
+	int pt_blk_sz;
+	int ct_blk_sz;
+	u1024_t *blocks;
 	u1024_t num_iv;
+	rsa_pool_t *pool;
+	rsa_chunks_t chunks;
+	int ret;
+} rsa_encrypt_t;
+
+static void rsa_encrypt_full_read(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_encrypt_t *enc = (rsa_encrypt_t*)arg;
+	char *pt_buf = (char*)buf->data;
+	int len, pt_buf_len = rsa_batch * enc->pt_blk_sz;
+
+	len = fread(pt_buf, sizeof(char), pt_buf_len, enc->plaintext);
+	buf->is_last = len != pt_buf_len;
+	buf->len = len ? (len-1)/enc->pt_blk_sz + 1 : 0;
+
+	/* pad the last block with zeros */
+	memset(pt_buf + len, 0, pt_buf_len - len);
+}
 
-	if (rsa_encrypt_prolog(&key, &plaintext, &ciphertext, 1))
+static void rsa_encrypt_full_compute(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_encrypt_t *enc = (rsa_encrypt_t*)arg;
+	u1024_t *ct_buf = enc->blocks;
+	char *data = (char*)buf->data;
+	int i, chunks_num;
+
+	for (i = 0; i < buf->len; i++) {
+		number_data2num(&ct_buf[i], data + i * enc->pt_blk_sz,
+			enc->pt_blk_sz);
+	}
+
+	switch (cipher_mode)
+	{
+	case CIPHER_MODE_CBC:
+		for (i = 0; i < buf->len; i++) {
+			number_xor(&ct_buf[i], &ct_buf[i], &enc->num_iv);
+			rsa_key_encode(enc->key, &ct_buf[i], &ct_buf[i]);
+			number_assign(enc->num_iv, ct_buf[i]);
+			enc->num_iv.arr[block_sz_u1024] = 0;
+			number_top_set(&enc->num_iv);
+		}
+		break;
+	case CIPHER_MODE_CBC_CHUNKED:
+		if ((chunks_num = rsa_chunks_init(&enc->chunks, enc->key,
+			ct_buf, buf->len)) < 0) {
+			enc->ret = -1;
+			break;
+		}
+		rsa_pool_run(enc->pool, rsa_encrypt_chunk, &enc->chunks,
+			chunks_num);
+		break;
+	case CIPHER_MODE_ECB:
+	default:
+		rsa_key_encode_blocks(enc->pool, enc->key, ct_buf, buf->len);
+		break;
+	}
+
+	/* ciphertext blocks are larger than plaintext ones, all the plaintext
+	 * has been consumed by now */
+	for (i = 0; i < buf->len; i++)
+		number_pack(data + i * enc->ct_blk_sz, &ct_buf[i]);
+}
+
+static void rsa_encrypt_full_write(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_encrypt_t *enc = (rsa_encrypt_t*)arg;
+	int i;
+
+	fwrite(buf->data, enc->ct_blk_sz, buf->len, enc->ciphertext);
+	for (i = 0; i < buf->len; i++)
+		rsa_timeline_update();
+}
+
+int rsa_encrypt_full(void)
+{
+	rsa_encrypt_t enc;
+
+	memset(&enc, 0, sizeof(rsa_encrypt_t));
+	if (rsa_encrypt_prolog(&enc.key, &enc.plaintext, &enc.ciphertext, 1))
 		return -1;
 
-	/* determine plaintext and ciphertext buffer lengths */
-	pt_blk_sz = rsa_encryption_level/sizeof(u64);
-	pt_buf_len = BLOCKS_PER_DATA_BUF * pt_blk_sz;
-	ct_blk_sz = number_size(rsa_encryption_level);
-	ct_buf_len = BLOCKS_PER_DATA_BUF * ct_blk_sz;
+	/* determine plaintext and ciphertext block sizes */
+	enc.pt_blk_sz = rsa_encryption_level/sizeof(u64);
+	enc.ct_blk_sz = number_size(rsa_encryption_level);
+	if (!(enc.blocks = rsa_buf_get(rsa_batch * sizeof(u1024_t)))) {
+		rsa_encrypt_abort(enc.key, enc.plaintext, enc.ciphertext);
+		return -1;
+	}
 
 	/* cipher mode initialization */
 	switch (cipher_mode)
 	{
 	case CIPHER_MODE_CBC:
-		number_init_random(&num_iv, block_sz_u1024);
+		number_init_random(&enc.num_iv, block_sz_u1024);
+		break;
+	case CIPHER_MODE_CBC_CHUNKED:
+		/* chunks are independent and are encoded in parallel */
+		if (rsa_chunks_alloc(&enc.chunks, rsa_batch)) {
+			rsa_buf_put(enc.blocks);
+			rsa_encrypt_abort(enc.key, enc.plaintext,
+				enc.ciphertext);
+			return -1;
+		}
+		enc.pool = rsa_chunks_pool_create(rsa_threads);
 		break;
 	case CIPHER_MODE_ECB:
 	default:
+		/* ecb blocks are independent and are encoded in parallel */
+		enc.pool = rsa_pool_create(rsa_threads);
 		break;
 	}
 
+	/* read, encode and write buffers concurrently */
 	rsa_timeline_init(file_size, block_sz_u1024*sizeof(u64));
-	do {
-		char pt_buf[pt_buf_len];
-		u1024_t ct_buf[ct_buf_len];
-		int i;
-
-		len = fread(pt_buf, sizeof(char), pt_buf_len, plaintext);
-		for (i = 0; len && i < (len-1)/pt_blk_sz + 1; i++) {
-			number_data2num(&ct_buf[i], &pt_buf[i*pt_blk_sz],
-				pt_blk_sz);
-
-			/* pre encryption cipher mode handling */
-			switch (cipher_mode)
-			{
-			case CIPHER_MODE_CBC:
-				number_xor(&ct_buf[i], &ct_buf[i], &num_iv);
-				break;
-			case CIPHER_MODE_ECB:
-			default:
-				break;
-			}
-
-			rsa_encode(&ct_buf[i], &ct_buf[i], &key->exp, &key->n);
-
-			/* post encryption cipher mode handling */
-			switch (cipher_mode)
-			{
-			case CIPHER_MODE_CBC:
-				number_assign(num_iv, ct_buf[i]);
-				num_iv.arr[block_sz_u1024] = 0;
-				number_top_set(&num_iv);
-				break;
-			case CIPHER_MODE_ECB:
-			default:
-				break;
-			}
-
-			rsa_write_u1024_full(ciphertext, &ct_buf[i]);
-			rsa_timeline_update();
-		}
+	if (rsa_pipe_run(rsa_encrypt_full_read, rsa_encrypt_full_compute,
+		rsa_encrypt_full_write, &enc, rsa_batch * enc.ct_blk_sz)) {
+		enc.ret = -1;
 	}
-	while (len == pt_buf_len);
 	rsa_timeline_uninit();
-
-	rsa_encrypt_epilog(key, plaintext, ciphertext);
-	return 0;
+	rsa_pool_destroy(enc.pool);
+	rsa_chunks_free(&enc.chunks);
+	rsa_buf_put(enc.blocks);
+
+	if (enc.ret)
+		rsa_encrypt_abort(enc.key, enc.plaintext, enc.ciphertext);
+	else
+		rsa_encrypt_epilog(enc.key, enc.plaintext, enc.ciphertext);
+	return enc.ret;
 }
-
@@ -17,6 +17,17 @@ static opt_t options_encrypter[] = {
 	{RSA_OPT_CBC, 'c', "cbc", no_argument, "full RSA encryption using "
 		"Cipher Block Chaining (CBC) cipher mode. by default "
 		"Electronic Codebook (ECB) is used"},
+	{RSA_OPT_CBC_CHUNKED, 'C', "chunked", no_argument, "full RSA "
+		"encryption using chunked CBC cipher mode. the data is split "
+		"into chunks which are chained on their own, so that chunks "
+		"are encrypted in parallel (see --threads)"},
+	{RSA_OPT_THREADS, 't', "threads", required_argument, "full RSA "
+		"encrypt using " ARG " threads (default 1). ECB blocks and "
+		"chunked CBC chunks are independent and are encoded in "
+		"parallel"},
+	{RSA_OPT_BATCH, 'b', "batch", required_argument, "full RSA "
+		"encrypt " ARG " blocks at a time (default 128). " ARG " is a "
+		"multiple of 8 up to 4096"},
 	{RSA_OPT_KEY_SET_DYNAMIC, 'k', "key", required_argument, "set the RSA "
 		"key to be used for the current encryption. this options "
 		"overrides the default key if it has been set"},
@@ -29,8 +40,15 @@ static opt_t options_encrypter[] = {
 /* encryption task is to be performed */
 static int parse_args_finalize_encrypter(unsigned int *flags, int actions)
 {
-	/* RSA_OPT_CBC implies RSA_OPT_RSAENC */
-	if (*flags & (OPT_FLAG(RSA_OPT_CBC)))
+	/* only one of RSA_OPT_CBC and RSA_OPT_CBC_CHUNKED may be set */
+	if ((*flags & OPT_FLAG(RSA_OPT_CBC)) &&
+		(*flags & OPT_FLAG(RSA_OPT_CBC_CHUNKED))) {
+		rsa_error_message(RSA_ERR_CIPHER_MODE);
+		return -1;
+	}
+
+	/* RSA_OPT_CBC and RSA_OPT_CBC_CHUNKED imply RSA_OPT_RSAENC */
+	if (*flags & (OPT_FLAG(RSA_OPT_CBC) | OPT_FLAG(RSA_OPT_CBC_CHUNKED)))
 		*flags |= OPT_FLAG(RSA_OPT_RSAENC);
 
 	if (!actions)
@@ -67,6 +85,20 @@ static int parse_args_encrypter(int opt, unsigned int *flags)
 		OPT_ADD(flags, RSA_OPT_CBC);
 		cipher_mode = CIPHER_MODE_CBC;
 		break;
+	case RSA_OPT_CBC_CHUNKED:
+		OPT_ADD(flags, RSA_OPT_CBC_CHUNKED);
+		cipher_mode = CIPHER_MODE_CBC_CHUNKED;
+		break;
+	case RSA_OPT_THREADS:
+		OPT_ADD(flags, RSA_OPT_THREADS);
+		if (rsa_threads_set(optarg))
+			return -1;
+		break;
+	case RSA_OPT_BATCH:
+		OPT_ADD(flags, RSA_OPT_BATCH);
+		if (rsa_batch_set(optarg))
+			return -1;
+		break;
 	case RSA_OPT_KEY_SET_DYNAMIC:
 		OPT_ADD(flags, RSA_OPT_KEY_SET_DYNAMIC);
 		if (optarg && rsa_set_key_name(optarg))
@@ -22,6 +22,17 @@ static opt_t options_master[] = {
 	{RSA_OPT_CBC, 'c', "cbc", no_argument, "full RSA encryption using "
 		"Cipher Block Chaining (CBC) cipher mode. by default "
 		"Electronic Codebook (ECB) is used"},
+	{RSA_OPT_CBC_CHUNKED, 'C', "chunked", no_argument, "full RSA "
+		"encryption using chunked CBC cipher mode. the data is split "
+		"into chunks which are chained on their own, so that chunks "
+		"are encrypted in parallel (see --threads)"},
+	{RSA_OPT_THREADS, 't', "threads", required_argument, "full RSA "
+		"encrypt/decrypt using " ARG " threads (default 1). ECB blocks "
+		"and chunked CBC chunks are coded in parallel, CBC blocks are "
+		"decoded in parallel"},
+	{RSA_OPT_BATCH, 'b', "batch", required_argument, "full RSA "
+		"encrypt/decrypt " ARG " blocks at a time (default 128). " ARG " is a "
+		"multiple of 8 up to 4096"},
 	{RSA_OPT_KEY_SET_DYNAMIC, 'k', "key", required_argument, "set the RSA "
 		"key to be used for the current encryption. this options "
 		"overrides the default key if it has been set. this switch "
@@ -33,6 +44,14 @@ static opt_t options_master[] = {
 		"after it has been encrypted/decrypted"},
 	{RSA_OPT_KEYGEN, 'g', "generate", required_argument, "generate an RSA "
 		"public/private key pair. " ARG " is its name"},
+	{RSA_OPT_KEYGEN_F4, 'F', "f4", no_argument, "use the fixed public "
+		"exponent 65537 (F4) when generating a key pair. public key "
+		"operations are considerably faster than with the default "
+		"random public exponent"},
+	{RSA_OPT_KEYGEN_THREADS, 'j', "jobs", required_argument, "generate "
+		"a key pair using " ARG " threads (default 1). the encryption "
+		"levels are generated concurrently and threads race on finding "
+		"their primes"},
 	{RSA_OPT_ENC_INFO_ONLY, 'i', "info", no_argument, "get info regarding "
 		"an encrypted file. this depends on possessing the required "
 		"private key"},
@@ -42,8 +61,15 @@ static opt_t options_master[] = {
 /* either encryption or decryption task are to be performed */
 static int parse_args_finalize_master(unsigned int *flags, int actions)
 {
-	/* RSA_OPT_CBC implies RSA_OPT_RSAENC */
-	if (*flags & (OPT_FLAG(RSA_OPT_CBC)))
+	/* only one of RSA_OPT_CBC and RSA_OPT_CBC_CHUNKED may be set */
+	if ((*flags & OPT_FLAG(RSA_OPT_CBC)) &&
+		(*flags & OPT_FLAG(RSA_OPT_CBC_CHUNKED))) {
+		rsa_error_message(RSA_ERR_CIPHER_MODE);
+		return -1;
+	}
+
+	/* RSA_OPT_CBC and RSA_OPT_CBC_CHUNKED imply RSA_OPT_RSAENC */
+	if (*flags & (OPT_FLAG(RSA_OPT_CBC) | OPT_FLAG(RSA_OPT_CBC_CHUNKED)))
 		*flags |= OPT_FLAG(RSA_OPT_RSAENC);
 
 	/* RSA_OPT_LEVEL, RSA_OPT_RSAENC and RSA_OPT_KEY_SET_DYNAMIC imply
@@ -63,6 +89,20 @@ static int parse_args_finalize_master(unsigned int *flags, int actions)
 	if (*flags & OPT_FLAG(RSA_OPT_KEYGEN))
 		actions++;
 
+	/* RSA_OPT_KEYGEN_F4 requires RSA_OPT_KEYGEN */
+	if ((*flags & OPT_FLAG(RSA_OPT_KEYGEN_F4)) &&
+		!(*flags & OPT_FLAG(RSA_OPT_KEYGEN))) {
+		rsa_error_message(RSA_ERR_KEYGEN_F4);
+		return -1;
+	}
+
+	/* RSA_OPT_KEYGEN_THREADS requires RSA_OPT_KEYGEN */
+	if ((*flags & OPT_FLAG(RSA_OPT_KEYGEN_THREADS)) &&
+		!(*flags & OPT_FLAG(RSA_OPT_KEYGEN))) {
+		rsa_error_message(RSA_ERR_KEYGEN_THREADS);
+		return -1;
+	}
+
 	/* test for a single action option */
 	if (actions != 1) {
 		rsa_error_message(actions ?
@@ -104,6 +144,20 @@ static int parse_args_master(int opt, unsigned int *flags)
 		OPT_ADD(flags, RSA_OPT_CBC);
 		cipher_mode = CIPHER_MODE_CBC;
 		break;
+	case RSA_OPT_CBC_CHUNKED:
+		OPT_ADD(flags, RSA_OPT_CBC_CHUNKED);
+		cipher_mode = CIPHER_MODE_CBC_CHUNKED;
+		break;
+	case RSA_OPT_THREADS:
+		OPT_ADD(flags, RSA_OPT_THREADS);
+		if (rsa_threads_set(optarg))
+			return -1;
+		break;
+	case RSA_OPT_BATCH:
+		OPT_ADD(flags, RSA_OPT_BATCH);
+		if (rsa_batch_set(optarg))
+			return -1;
+		break;
 	case RSA_OPT_KEY_SET_DYNAMIC:
 		OPT_ADD(flags, RSA_OPT_KEY_SET_DYNAMIC);
 		if (optarg && rsa_set_key_name(optarg))
@@ -121,6 +175,15 @@ static int parse_args_master(int opt, unsigned int *flags)
 		if (rsa_set_key_data(optarg))
 			return -1;
 		break;
+	case RSA_OPT_KEYGEN_F4:
+		OPT_ADD(flags, RSA_OPT_KEYGEN_F4);
+		is_keygen_f4 = 1;
+		break;
+	case RSA_OPT_KEYGEN_THREADS:
+		OPT_ADD(flags, RSA_OPT_KEYGEN_THREADS);
+		if (rsa_keygen_threads_set(optarg))
+			return -1;
+		break;
 	case RSA_OPT_ENC_INFO_ONLY:
 		OPT_ADD(flags, RSA_OPT_ENC_INFO_ONLY);
 		is_encryption_info_only = 1;
@@ -16,28 +16,53 @@
 #define COPRIME_DIVISOR(X) ((X).divisor)
 #define ASCII_LEN_2_BIN_LEN(STR) (strlen(STR)<<3)
 #define NUMBER_GENERATE_COPRIME_ARRAY_SZ 13
+#define NUMBER_EXPONENTIATION_WINDOW_MAX 6
+#define NUMBER_EXPONENTIATION_SHORT 32
+#define NUMBER_MONTGOMERY_CTX_DOUBLINGS 16
+#define NUMBER_SIEVE_PRIMES 2048
+#define NUMBER_LANES_MIN 2 /* fewer are exponentiated one by one */
+/* leading bits simulated by lehmer's gcd, 2 short of a limb so that neither
+ * they nor their cofactors overflow */
+#define NUMBER_LEHMER_BITS (bit_sz_u64 - 2)
+
+/* karatsuba multiplication threshold in limbs. it can be tuned at compilation
+ * time (KARATSUBA_THRESHOLD=<limbs>) and must be at least 4 */
+#ifndef NUMBER_KARATSUBA_THRESHOLD
+#define NUMBER_KARATSUBA_THRESHOLD 8
+#endif
+#if NUMBER_KARATSUBA_THRESHOLD < 4
+#error "NUMBER_KARATSUBA_THRESHOLD must be at least 4"
+#endif
 
-#define number_gcd_is_1(u, v) \
-	( \
-	  /* algorithm \
-	   * --------- \
-	   * g = 0 \
-	   * while u is even and v is even \
-	   *   u = u/2 (right shift) \
-	   *   v = v/2 \
-	   *   g = g + 1 \
-	   * now u or v (or both) are odd \
-	   * while u > 0 \
-	   *   if u is even, u = u/2 \
-	   *   else if v is even, v = v/2 \
-	   *   else if u >= v \
-	   *     u = (u-v)/2 \
-	   *   else \
-	   *     v = (v-u)/2 \
-	   * return v/2^k \
-	   * Since radix is of the form 2^k, and n is odd, their GCD is 1 */ \
-	  1 \
-	)
+/* kernel templates are inlined into each of their instances, test builds
+ * included. their inner loops are unrolled into straight line code, the
+ * outer one is not: at 16 limbs that only bloats the code */
+#define NUMBER_KERNEL_INLINE inline __attribute__((always_inline))
+#define NUMBER_KERNEL_UNROLL _Pragma("GCC unroll 16")
+
+/* x86-64 kernels using MULX with the independent ADCX/ADOX carry chains. they
+ * are built unless ADX=n and are used if cpuid reports bmi2 and adx support */
+#if defined(NUMBER_ADX) && defined(ULLONG) && defined(__x86_64__)
+#define NUMBER_KERNELS_ADX
+#include <cpuid.h>
+#endif
+
+/* AVX-512 IFMA montgomery product in a 2^52 radix, used on top of the ADX
+ * kernels if the cpu supports it. it is built unless IFMA=n */
+#if defined(NUMBER_IFMA) && defined(NUMBER_KERNELS_ADX)
+#define NUMBER_KERNELS_IFMA
+#define NUMBER_IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+#define NUMBER_IFMA_LIMB 64
+#define NUMBER_IFMA_DIGIT 52
+#define NUMBER_IFMA_MASK (((u64)1 << NUMBER_IFMA_DIGIT) - 1)
+#define NUMBER_IFMA_VECTORS 3 /* 24 digits, 1024 bits need 21 */
+#define NUMBER_IFMA_DIGITS 20 /* 1024 bits */
+#define NUMBER_LANES_UNROLL _Pragma("GCC unroll 20")
+#include <immintrin.h>
+#endif
+
+#define NUMBER_BIT(num, i) ((*((u64*)&(num)->arr + (i) / bit_sz_u64) >> \
+	((i) % bit_sz_u64)) & (u64)1)
 
 u1024_t NUM_0 = { .arr[0] = 0 };
 u1024_t NUM_1 = { .arr[0] = 1 };
@@ -45,22 +70,44 @@ u1024_t NUM_2 = { .arr[0] = 2 };
 u1024_t NUM_5 = { .arr[0] = 5 };
 u1024_t NUM_10 = { .arr[0] = 10 };
 int bit_sz_u64 = sizeof(u64) << 3;
-int encryption_level;
-int block_sz_u1024;
+/* the encryption level, the prng state and the prime search tables are per
+ * thread, so that threads may work at different encryption levels */
+__thread int encryption_level;
+__thread int block_sz_u1024;
 int encryption_levels[] = { /* 64,*/ 128, 256, 512, 1024, 0 };
 
-typedef int (*func_modular_multiplication_t) (u1024_t *num_res,
-	u1024_t *num_a, u1024_t *num_b, u1024_t *num_n);
 typedef struct code2list_t {
 	int code;
 	u64 list[NUMBER_GENERATE_COPRIME_ARRAY_SZ];
 	int disabled;
 } code2list_t;
 
-STATIC u1024_t num_montgomery_n, num_res_nresidue;
-static u1024_t num_montgomery_factor;
-STATIC prng_seed_t number_random_seed;
-static int number_generate_coprime_init;
+/* arithmetic kernels for a given block size, 0 for any */
+typedef struct {
+	int block_sz;
+	void (*montgomery_product)(u64 *res, u64 *a, u64 *b, u64 *n,
+		u64 n0inv);
+	/* base case of karatsuba multiplication, any len */
+	void (*mul)(u64 *res, u64 *a, u64 *b, int len);
+	/* up to NUMBER_LANES exponentiations at once, if any */
+	void (*montgomery_exponentiation_lanes)(u1024_t **res, u1024_t **a,
+		int num, u1024_t *b, montgomery_ctx_t *ctx);
+} number_kernels_t;
+
+/* the thread's own prng and that of the number context in effect, if any */
+static __thread prng_t number_prng_thread = {
+#ifdef MERSENNE_TWISTER
+	.mt = MT19937_64_INITIALIZER,
+#endif
+};
+static __thread prng_t *number_prng;
+#define NUMBER_PRNG (number_prng ? number_prng : &number_prng_thread)
+static __thread int number_generate_coprime_init;
+static __thread unsigned int number_sieve_primes[NUMBER_SIEVE_PRIMES];
+static __thread unsigned long number_sieve_hits, number_sieve_misses;
+
+static __thread number_kernels_t *number_kernel;
+static void number_kernels_select(void);
 
 static u64 *code2list(code2list_t *list, int code)
 {
@@ -79,6 +126,7 @@ int number_enclevl_set(int level)
 
 	encryption_level = level;
 	block_sz_u1024 = encryption_level / bit_sz_u64;
+	number_kernels_select();
 	number_generate_coprime_init = 0;
 
 	return 0;
@@ -99,68 +147,96 @@ int number_size(int level)
 	return sizeof(int) + (level + bit_sz_u64) / sizeof(u64);
 }
 
+/* level sized storage of a number: its block_sz_u1024 + 1 significant u64s
+ * followed by top, number_size(encryption_level) bytes in all. this is the
+ * layout of full numbers in files */
+void number_pack(void *packed, u1024_t *num)
+{
+	int len = (block_sz_u1024 + 1) * sizeof(u64);
+
+	memcpy(packed, num->arr, len);
+	memcpy((char*)packed + len, &num->top, sizeof(int));
+}
+
+/* the u64s of num above its buffer are left untouched */
+void number_unpack(u1024_t *num, void *packed)
+{
+	int len = (block_sz_u1024 + 1) * sizeof(u64);
+
+	memcpy(num->arr, packed, len);
+	memcpy(&num->top, (char*)packed + len, sizeof(int));
+}
+
+/* res = num1 + num2, carrying into the buffer. a carry out of the buffer
+ * resets it. the carry chain runs up to the longer operand's top, limbs above
+ * top are assumed to be 0 */
 void INLINE number_add(u1024_t *res, u1024_t *num1, u1024_t *num2)
 {
-	u1024_t num_big, num_small, num_res;
-	u64 *top, *top_max, *seg = NULL, *seg1 = NULL, *seg2 = NULL, carry = 0;
+	u64 *r = (u64*)&res->arr, *a = (u64*)&num1->arr, *b = (u64*)&num2->arr;
+	u64 carry = 0;
+	int i, top = num1->top, top_short = num2->top;
 
 	TIMER_START(FUNC_NUMBER_ADD);
-	/* set num_big => num_small */
-	if (number_is_greater_or_equal(num1, num2)) {
-		number_assign(num_big, *num1);
-		number_assign(num_small, *num2);
+	/* a is the longer operand */
+	if (top < top_short) {
+		u64 *tmp = a;
+
+		a = b;
+		b = tmp;
+		top = num2->top;
+		top_short = num1->top;
 	}
-	else {
-		number_assign(num_big, *num2);
-		number_assign(num_small, *num1);
-	}
-
-	number_assign(num_res, num_big);
-	top = (u64*)&num_res.arr + num_small.top + 1;
-	for (seg = (u64*)&num_res.arr, seg1 = (u64*)&num_big.arr,
-		seg2 = (u64*)&num_small.arr; seg < top; seg++, seg1++, seg2++) {
-		*seg = *seg1 + *seg2 + carry;
-		if ((*seg1 & MSB(u64)) && (*seg2 & MSB(u64)))
-			carry = 1;
-		else if (!(*seg1 & MSB(u64)) && !(*seg2 & MSB(u64)))
-			carry = 0;
-		else
-			carry = (*seg & MSB(u64)) ? 0 : 1;
-	}
-
-	top_max = (u64*)&num_res.arr + block_sz_u1024;
-	for ( ; carry && seg <= top_max; seg++) {
-		carry = *seg == (u64)-1;
-		(*seg)++;
-		if (seg > (u64*)&num_res.arr + num_res.top)
-			num_res.top++;
-	}
-	if (num_res.top > block_sz_u1024)
-		num_res.top--;
-	if (carry)
-		number_reset_buffer(&num_res);
-	number_assign(*res, num_res);
+
+	for (i = 0; i <= top_short; i++) {
+		u128 acc = (u128)a[i] + b[i] + carry;
+
+		r[i] = (u64)acc;
+		carry = (u64)(acc >> bit_sz_u64);
+	}
+	for ( ; i <= top; i++) {
+		u128 acc = (u128)a[i] + carry;
+
+		r[i] = (u64)acc;
+		carry = (u64)(acc >> bit_sz_u64);
+	}
+
+	if (carry) {
+		if (top < block_sz_u1024) {
+			r[++top] = carry;
+		}
+		else {
+			/* carry out of the buffer */
+			r[top] = 0;
+			while (top && !r[top])
+				top--;
+		}
+	}
+
+	for (i = top + 1; i <= block_sz_u1024; i++)
+		r[i] = 0;
+	res->top = top;
 	TIMER_STOP(FUNC_NUMBER_ADD);
 }
 
 static prng_seed_t number_seed_set(prng_seed_t seed)
 {
-	if (!(number_random_seed = seed)) {
+	prng_t *prng = NUMBER_PRNG;
+
+	if (!(prng->seed = seed)) {
 		struct timeval tv;
 
 		tv.tv_sec = tv.tv_usec = 0;
 		if (gettimeofday(&tv, NULL))
 			return 0;
-		number_random_seed =
-			(prng_seed_t)tv.tv_sec * (prng_seed_t)tv.tv_usec;
+		prng->seed = (prng_seed_t)tv.tv_sec * (prng_seed_t)tv.tv_usec;
 	}
 
 #ifdef MERSENNE_TWISTER
-	init_genrand64(number_random_seed);
+	init_genrand64_r(&prng->mt, prng->seed);
 #else
-	srandom(number_random_seed);
+	srandom(prng->seed);
 #endif
-	return number_random_seed;
+	return prng->seed;
 }
 
 int number_seed_set_random(u1024_t *seed)
@@ -168,7 +244,7 @@ int number_seed_set_random(u1024_t *seed)
 	if (!number_seed_set(0))
 		return -1;
 	number_reset(seed);
-	return number_data2num(seed, &number_random_seed, sizeof(prng_seed_t));
+	return number_data2num(seed, &NUMBER_PRNG->seed, sizeof(prng_seed_t));
 }
 
 int number_seed_set_fixed(u1024_t *seed)
@@ -176,13 +252,31 @@ int number_seed_set_fixed(u1024_t *seed)
 	return number_seed_set(*(prng_seed_t*)&seed->arr) ? 0 : -1;
 }
 
+#ifdef TESTS
+/* have the next number_init_random() reseed the thread's prng */
+void number_prng_reset(void)
+{
+	NUMBER_PRNG->seed = 0;
+}
+#endif
+
+/* the next value of the prng in effect */
+u64 number_random(void)
+{
+#ifdef MERSENNE_TWISTER
+	return (u64)genrand64_int64_r(&NUMBER_PRNG->mt);
+#else
+	return (u64)random();
+#endif
+}
+
 /* initiates the first low (u64) blocks of num with random values */
 int INLINE number_init_random(u1024_t *num, int blocks)
 {
 	int i, ret;
 
 	TIMER_START(FUNC_NUMBER_INIT_RANDOM);
-	if (blocks < 1 || blocks > block_sz_u1024 || (!number_random_seed &&
+	if (blocks < 1 || blocks > block_sz_u1024 || (!NUMBER_PRNG->seed &&
 		!number_seed_set(0))) {
 		ret = -1;
 		goto Exit;
@@ -238,67 +332,209 @@ void INLINE number_small_dec2num(u1024_t *num_n, u64 dec)
 	TIMER_STOP(FUNC_NUMBER_SMALL_DEC2NUM);
 }
 
-STATIC void INLINE number_2complement(u1024_t *res, u1024_t *num)
+/* res = num1 - num2 modulo 2^(bit_sz_u64 * block_sz_u1024) (two's
+ * complement), the buffer is reset. the borrow chain runs up to the longer
+ * operand's top, limbs above top are assumed to be 0 */
+void INLINE number_sub(u1024_t *res, u1024_t *num1, u1024_t *num2)
 {
-	u1024_t tmp;
-	u64 *seg = NULL, *seg_max = (u64 *)&tmp.arr + block_sz_u1024;
-	int cur_block;
+	u64 *r = (u64*)&res->arr, *a = (u64*)&num1->arr, *b = (u64*)&num2->arr;
+	u64 borrow = 0;
+	int i, top1 = num1->top, top2 = num2->top, top;
 
-	TIMER_START(FUNC_NUMBER_2COMPLEMENT);
-	number_assign(tmp, *num);
-	for (seg = (u64 *)&tmp.arr, cur_block = 0; seg <= seg_max; seg++,
-		cur_block++) {
-		if ((*seg = ~*seg)) /* one's complement */
-			tmp.top = cur_block;
+	TIMER_START(FUNC_NUMBER_SUB);
+	/* buffers do not take part */
+	if (top1 == block_sz_u1024)
+		top1--;
+	if (top2 == block_sz_u1024)
+		top2--;
+	top = top1 > top2 ? top1 : top2;
+
+	for (i = 0; i <= top; i++) {
+		u64 limb_a = i <= top1 ? a[i] : 0;
+		u64 limb_b = i <= top2 ? b[i] : 0;
+		u64 diff = (u64)(limb_a - limb_b);
+		u64 borrow_out = limb_a < limb_b || diff < borrow;
+
+		r[i] = (u64)(diff - borrow);
+		borrow = borrow_out;
 	}
 
-	number_add(res, &tmp, &NUM_1); /* two's complement */
-	TIMER_STOP(FUNC_NUMBER_2COMPLEMENT);
+	/* a negative result is sign extended */
+	for ( ; i < block_sz_u1024; i++)
+		r[i] = borrow ? (u64)-1 : 0;
+	r[block_sz_u1024] = 0;
+
+	if (borrow)
+		top = block_sz_u1024 - 1;
+	while (top && !r[top])
+		top--;
+	res->top = top;
+	TIMER_STOP(FUNC_NUMBER_SUB);
 }
 
-void INLINE number_sub(u1024_t *res, u1024_t *num1, u1024_t *num2)
+/* r[0, rlen) += a[0, alen), alen <= rlen. returns the carry out of r */
+static u64 INLINE number_limbs_add(u64 *r, int rlen, u64 *a, int alen)
 {
-	u1024_t num2_2complement;
+	u64 carry = 0;
+	int i;
 
-	TIMER_START(FUNC_NUMBER_SUB);
-	number_2complement(&num2_2complement, num2);
-	number_add(res, num1, &num2_2complement);
-	number_reset_buffer(res);
-	TIMER_STOP(FUNC_NUMBER_SUB);
+	for (i = 0; i < alen; i++) {
+		u128 acc = (u128)r[i] + a[i] + carry;
+
+		r[i] = (u64)acc;
+		carry = (u64)(acc >> bit_sz_u64);
+	}
+	for ( ; carry && i < rlen; i++) {
+		r[i]++;
+		carry = !r[i];
+	}
+
+	return carry;
 }
 
-void INLINE number_mul(u1024_t *res, u1024_t *num1, u1024_t *num2)
+/* r[0, rlen) -= a[0, alen), alen <= rlen and r >= a */
+static void INLINE number_limbs_sub(u64 *r, int rlen, u64 *a, int alen)
 {
-	int i, top;
-	u1024_t tmp_res, multiplicand = *num1, multiplier = *num2;
+	u64 borrow = 0;
+	int i;
 
-	TIMER_START(FUNC_NUMBER_MUL);
-	number_reset(&tmp_res);
-	top = num1->top + num2->top + 1;
-	for (i = 0; i < top; i++) {
-		u64 mask = 1;
-		int j;
-
-		for (j = 0; j < bit_sz_u64; j++) {
-			if ((*((u64*)&multiplier.arr + i)) & mask)
-				number_add(&tmp_res, &tmp_res, &multiplicand);
-			number_shift_left_once(&multiplicand);
-			number_reset_buffer(&multiplicand);
-			mask = mask << 1;
+	for (i = 0; i < alen; i++) {
+		u64 diff = (u64)(r[i] - a[i]);
+		u64 borrow_out = r[i] < a[i] || diff < borrow;
+
+		r[i] = (u64)(diff - borrow);
+		borrow = borrow_out;
+	}
+	for ( ; borrow && i < rlen; i++) {
+		borrow = !r[i];
+		r[i]--;
+	}
+}
+
+/* res[0, 2*len) = a[0, len) * b[0, len) */
+static void INLINE number_mul_schoolbook(u64 *res, u64 *a, u64 *b, int len)
+{
+	int i, j;
+
+	for (i = 0; i < 2 * len; i++)
+		res[i] = 0;
+
+	for (i = 0; i < len; i++) {
+		u64 carry = 0;
+
+		if (!a[i])
+			continue;
+
+		for (j = 0; j < len; j++) {
+			u128 acc = (u128)res[i + j] + (u128)a[i] * b[j] + carry;
+
+			res[i + j] = (u64)acc;
+			carry = (u64)(acc >> bit_sz_u64);
+		}
+		res[i + len] = carry;
+	}
+}
+
+/* res[0, 2*len) = a[0, len) * b[0, len)
+ * with a = a1*w^h + a0 and b = b1*w^h + b0:
+ *   z0 = a0*b0
+ *   z2 = a1*b1
+ *   z1 = (a0 + a1)*(b0 + b1) - z0 - z2
+ *   ab = z2*w^2h + z1*w^h + z0
+ * operands shorter than NUMBER_KARATSUBA_THRESHOLD limbs are multiplied by
+ * schoolbook multiplication */
+static void number_mul_karatsuba(u64 *res, u64 *a, u64 *b, int len)
+{
+	int h = len >> 1, m = len - h;
+	u64 sum_a[m + 1], sum_b[m + 1], z1[2 * (m + 1)];
+	int i;
+
+	if (len < NUMBER_KARATSUBA_THRESHOLD) {
+		number_kernel->mul(res, a, b, len);
+		return;
+	}
+
+	/* z0 at res[0, 2h), z2 at res[2h, 2len) */
+	number_mul_karatsuba(res, a, b, h);
+	number_mul_karatsuba(res + 2 * h, a + h, b + h, m);
+
+	for (i = 0; i < m; i++) {
+		sum_a[i] = a[h + i];
+		sum_b[i] = b[h + i];
+	}
+	sum_a[m] = 0;
+	sum_b[m] = 0;
+	number_limbs_add(sum_a, m + 1, a, h);
+	number_limbs_add(sum_b, m + 1, b, h);
+
+	number_mul_karatsuba(z1, sum_a, sum_b, m + 1);
+	number_limbs_sub(z1, 2 * (m + 1), res, 2 * h);
+	number_limbs_sub(z1, 2 * (m + 1), res + 2 * h, 2 * m);
+
+	/* z1 < w^(2len - h), its upper limbs are 0 */
+	number_limbs_add(res + h, 2 * len - h, z1,
+		2 * (m + 1) < 2 * len - h ? 2 * (m + 1) : 2 * len - h);
+}
+
+/* res[0, len) = a[0, len) * b[0, len) mod w^len */
+static void INLINE number_mul_low(u64 *res, u64 *a, u64 *b, int len)
+{
+	int i, j;
+
+	for (i = 0; i < len; i++)
+		res[i] = 0;
+
+	for (i = 0; i < len; i++) {
+		u64 carry = 0;
+
+		if (!a[i])
+			continue;
+
+		for (j = 0; j < len - i; j++) {
+			u128 acc = (u128)res[i + j] + (u128)a[i] * b[j] + carry;
+
+			res[i + j] = (u64)acc;
+			carry = (u64)(acc >> bit_sz_u64);
 		}
 	}
-	number_assign(*res, tmp_res);
+}
+
+/* the product is truncated to block_sz_u1024 limbs. if it fits, which is the
+ * case for all but the signed arithmetic of the extended euclid algorithm, it
+ * is calculated in full, by karatsuba multiplication. it is accumulated in
+ * res directly unless res is one of the operands */
+void INLINE number_mul(u1024_t *res, u1024_t *num1, u1024_t *num2)
+{
+	u64 tmp[2 * RSA_NUMBER_ARRAY_SZ];
+	u64 *a = (u64*)&num1->arr, *b = (u64*)&num2->arr, *prod;
+	int i, len, k = block_sz_u1024;
+
+	TIMER_START(FUNC_NUMBER_MUL);
+	prod = res == num1 || res == num2 ? tmp : (u64*)&res->arr;
+	len = (num1->top > num2->top ? num1->top : num2->top) + 1;
+	if (2 * len <= k)
+		number_mul_karatsuba(prod, a, b, len);
+	else
+		number_mul_low(prod, a, b, k);
+
+	for (i = prod == tmp ? 0 : 2 * len; i < k; i++)
+		*((u64*)&res->arr + i) = i < 2 * len ? prod[i] : 0;
+	*((u64*)&res->arr + k) = 0;
+	number_top_set(res);
 	TIMER_STOP(FUNC_NUMBER_MUL);
 }
 
 STATIC void INLINE number_absolute_value(u1024_t *abs, u1024_t *num)
 {
 	TIMER_START(FUNC_NUMBER_ABSOLUTE_VALUE);
-	number_assign(*abs, *num);
-	if (NUMBER_IS_NEGATIVE(num)) {
+	if (!NUMBER_IS_NEGATIVE(num)) {
+		if (abs != num)
+			number_assign(*abs, *num);
+	}
+	else {
 		u64 *seg;
 
-		number_sub(abs, abs, &NUM_1);
+		number_sub(abs, num, &NUM_1);
 		for (seg = (u64*)&abs->arr + block_sz_u1024 - 1;
 			seg >= (u64*)&abs->arr; seg--) {
 			*seg = ~*seg;
@@ -308,43 +544,271 @@ STATIC void INLINE number_absolute_value(u1024_t *abs, u1024_t *num)
 	TIMER_STOP(FUNC_NUMBER_ABSOLUTE_VALUE);
 }
 
+/* r[0, len) = a[0, len) << shift, returns the bits shifted out of a.
+ * 0 <= shift < bit_sz_u64 */
+static u64 INLINE number_limbs_shift_left(u64 *r, u64 *a, int len, int shift)
+{
+	u64 carry = 0;
+	int i;
+
+	if (!shift) {
+		for (i = 0; i < len; i++)
+			r[i] = a[i];
+		return 0;
+	}
+
+	for (i = 0; i < len; i++) {
+		u64 limb = a[i];
+
+		r[i] = (u64)(limb << shift) | carry;
+		carry = (u64)(limb >> (bit_sz_u64 - shift));
+	}
+
+	return carry;
+}
+
+/* long division - knuth, the art of computer programming, vol. 2, 4.3.1,
+ * algorithm D. with w = 2^bit_sz_u64, u the dividend (m + n limbs) and v the
+ * divisor (n limbs):
+ *   D1 normalize: shift u and v left by s so that v[n-1] >= w/2
+ *   for j = m down to 0 do
+ *     D3 qhat = (u[j+n]*w + u[j+n-1]) / v[n-1]
+ *        rhat = (u[j+n]*w + u[j+n-1]) % v[n-1]
+ *        while qhat >= w or qhat*v[n-2] > rhat*w + u[j+n-2] do
+ *          qhat = qhat - 1, rhat = rhat + v[n-1]
+ *          if rhat >= w then break
+ *        end while
+ *     D4 u[j, j+n] = u[j, j+n] - qhat*v
+ *     D5 q[j] = qhat
+ *     D6 if D4 borrowed then q[j] = q[j] - 1, u[j, j+n] = u[j, j+n] + v
+ *   end for
+ *   D8 unnormalize: r = u[0, n) >> s
+ * qhat is at most 1 too large after D3's test, so D6 is rarely taken.
+ * single limb divisors are divided limb by limb.
+ * here, the dividend is of m limbs, up to 2 * RSA_NUMBER_ARRAY_SZ, and the
+ * divisor of n, divisor[n - 1] != 0. only q[0, m - n] and r[0, n) are set */
+static void INLINE number_limbs_dev(u64 *q, u64 *r, u64 *dividend, int m,
+	u64 *divisor, int n)
+{
+	u64 u[2 * RSA_NUMBER_ARRAY_SZ + 2], v[RSA_NUMBER_ARRAY_SZ];
+	int i, j, shift;
+
+	/* dividend < divisor yields 0, dividend */
+	if (m < n) {
+		for (i = 0; i < m; i++)
+			r[i] = dividend[i];
+		return;
+	}
+
+	if (n == 1) {
+		u128 rem = 0;
+
+		for (i = m - 1; i >= 0; i--) {
+			u128 cur = (rem << bit_sz_u64) | dividend[i];
+
+			q[i] = (u64)(cur / divisor[0]);
+			rem = cur % divisor[0];
+		}
+		r[0] = (u64)rem;
+		return;
+	}
+
+	/* D1 */
+	for (shift = 0; !(divisor[n - 1] & (MSB(u64) >> shift)); shift++);
+	number_limbs_shift_left(v, divisor, n, shift);
+	u[m] = number_limbs_shift_left(u, dividend, m, shift);
+
+	for (j = m - n; j >= 0; j--) {
+		u128 num, qhat, rhat;
+		u64 borrow = 0, carry = 0, top;
+		int is_borrow;
+
+		/* D3 */
+		num = ((u128)u[j + n] << bit_sz_u64) | u[j + n - 1];
+		qhat = num / v[n - 1];
+		rhat = num % v[n - 1];
+		while ((qhat >> bit_sz_u64) || qhat * v[n - 2] >
+			((rhat << bit_sz_u64) | u[j + n - 2])) {
+			qhat--;
+			rhat += v[n - 1];
+			if (rhat >> bit_sz_u64)
+				break;
+		}
+
+		/* D4 */
+		for (i = 0; i < n; i++) {
+			u128 prod = qhat * v[i] + carry;
+			u64 prod_lo = (u64)prod;
+			u64 diff = (u64)(u[i + j] - prod_lo);
+			u64 borrow_out = u[i + j] < prod_lo || diff < borrow;
+
+			u[i + j] = (u64)(diff - borrow);
+			borrow = borrow_out;
+			carry = (u64)(prod >> bit_sz_u64);
+		}
+		top = (u64)(u[j + n] - carry);
+		is_borrow = u[j + n] < carry || top < borrow;
+		u[j + n] = (u64)(top - borrow);
+
+		/* D5 */
+		q[j] = (u64)qhat;
+
+		/* D6 */
+		if (is_borrow) {
+			q[j]--;
+			u[j + n] += number_limbs_add(u + j, n, v, n);
+		}
+	}
+
+	/* D8 */
+	for (i = 0; i < n; i++) {
+		r[i] = shift ? (u64)(u[i] >> shift) |
+			(u64)(u[i + 1] << (bit_sz_u64 - shift)) : u[i];
+	}
+}
+
+/* the dividend's buffer is ignored */
 void INLINE number_dev(u1024_t *num_q, u1024_t *num_r, u1024_t *num_dividend,
 	u1024_t *num_divisor)
 {
-	u1024_t dividend, divisor, quotient, remainder;
-	u64 *seg_dividend = (u64 *)&dividend.arr + block_sz_u1024 - 1;
-	u64 *remainder_ptr = (u64 *)&remainder.arr;
-	u64 *quotient_ptr = (u64 *)&quotient.arr;
+	u64 q[RSA_NUMBER_ARRAY_SZ], r[RSA_NUMBER_ARRAY_SZ];
+	u64 *dividend = (u64*)&num_dividend->arr;
+	u64 *divisor = (u64*)&num_divisor->arr;
+	int i, m, n, k = block_sz_u1024;
 
 	TIMER_START(FUNC_NUMBER_DEV);
-	number_assign(dividend, *num_dividend);
-	number_assign(divisor, *num_divisor);
-	number_reset(&remainder);
-	number_reset(&quotient);
-	while (seg_dividend >= (u64 *)&dividend) {
-		u64 mask_dividend = MSB(u64);
-
-		while (mask_dividend) {
-			number_shift_left_once(&remainder);
-			number_reset_buffer(&remainder);
-			number_shift_left_once(&quotient);
-			number_reset_buffer(&quotient);
-			*remainder_ptr = *remainder_ptr |
-				((*seg_dividend & mask_dividend) ?
-				 (u64)1 : (u64)0);
-			if (number_is_greater_or_equal(&remainder, &divisor)){
-				*quotient_ptr = *quotient_ptr | (u64)1;
-				number_sub(&remainder, &remainder, &divisor);
-			}
-			mask_dividend = mask_dividend >> 1;
-		}
-		seg_dividend--;
+	for (i = 0; i < k; i++) {
+		q[i] = 0;
+		r[i] = 0;
+	}
+
+	for (m = k; m && !dividend[m - 1]; m--);
+	for (n = k; n && !divisor[n - 1]; n--);
+
+	/* division by zero yields 0, dividend */
+	if (!n) {
+		for (i = 0; i < m; i++)
+			r[i] = dividend[i];
+	}
+	else {
+		number_limbs_dev(q, r, dividend, m, divisor, n);
 	}
-	number_assign(*num_q, quotient);
-	number_assign(*num_r, remainder);
+
+	for (i = 0; i < k; i++) {
+		*((u64*)&num_q->arr + i) = q[i];
+		*((u64*)&num_r->arr + i) = r[i];
+	}
+	*((u64*)&num_q->arr + k) = 0;
+	*((u64*)&num_r->arr + k) = 0;
+	number_top_set(num_q);
+	number_top_set(num_r);
 	TIMER_STOP(FUNC_NUMBER_DEV);
 }
 
+/* barrett reduction - menezes, van oorschot and vanstone, handbook of applied
+ * cryptography, 14.42. with b = 2^bit_sz_u64 and m of k limbs, the reciprocal
+ * mu = b^2k / m is set up once per modulus. for 0 <= x < b^2k:
+ *   q = ((x / b^(k-1)) * mu) / b^(k+1), at most 3 short of x / m
+ *   r = (x - q*m) mod b^(k+1)
+ *   while r >= m, r = r - m, q = q + 1
+ * the partial products of (x / b^(k-1)) * mu below b^(k-1), which can take at
+ * most 1 off q, and those of q*m from b^(k+1) up are not calculated.
+ * assumption: m > 0 */
+void number_barrett_ctx_init(barrett_ctx_t *ctx, u1024_t *num_m)
+{
+	u64 x[2 * RSA_NUMBER_ARRAY_SZ + 1], q[2 * RSA_NUMBER_ARRAY_SZ + 1];
+	u64 r[RSA_NUMBER_ARRAY_SZ], *m = (u64*)&num_m->arr;
+	int i, k;
+
+	number_assign(ctx->m, *num_m);
+	for (k = block_sz_u1024; !m[k - 1]; k--);
+	ctx->k = k;
+
+	for (i = 0; i <= 2 * k; i++) {
+		x[i] = i == 2 * k;
+		q[i] = 0;
+	}
+	number_limbs_dev(q, r, x, 2 * k + 1, m, k);
+	for (i = 0; i < k + 2; i++)
+		ctx->mu[i] = q[i];
+}
+
+/* numbers of more than 2k limbs are divided by number_dev(). num_q and num_r
+ * may be num_x */
+void number_barrett_dev(u1024_t *num_q, u1024_t *num_r, u1024_t *num_x,
+	barrett_ctx_t *ctx)
+{
+	u64 q1[RSA_NUMBER_ARRAY_SZ + 1], q2[2 * RSA_NUMBER_ARRAY_SZ + 4];
+	u64 qm[RSA_NUMBER_ARRAY_SZ + 1], r[RSA_NUMBER_ARRAY_SZ + 1];
+	u64 *x = (u64*)&num_x->arr, *m = (u64*)&ctx->m.arr, *mu = ctx->mu;
+	u64 *q = q2 + ctx->k + 1, one = 1;
+	int i, j, k = ctx->k, top = num_x->top, len;
+
+	if (top >= 2 * k) {
+		number_dev(num_q, num_r, num_x, &ctx->m);
+		return;
+	}
+
+	TIMER_START(FUNC_NUMBER_BARRETT_DEV);
+	for (i = 0; i <= k; i++) {
+		q1[i] = k - 1 + i <= top ? x[k - 1 + i] : 0;
+		r[i] = i <= top ? x[i] : 0;
+		qm[i] = 0;
+	}
+	for (i = 0; i < 2 * k + 4; i++)
+		q2[i] = 0;
+
+	/* q2 = q1 * mu, from b^(k-1) up. q1 is of len limbs */
+	len = top - k + 2 > 0 ? top - k + 2 : 0;
+	for (i = 0; i < len; i++) {
+		u64 carry = 0;
+
+		for (j = i < k - 1 ? k - 1 - i : 0; j < k + 2; j++) {
+			u128 acc = (u128)q2[i + j] + (u128)q1[i] * mu[j] +
+				carry;
+
+			q2[i + j] = (u64)acc;
+			carry = (u64)(acc >> bit_sz_u64);
+		}
+		q2[i + k + 2] = carry;
+	}
+
+	/* qm = q * m mod b^(k+1) */
+	for (i = 0; i <= k; i++) {
+		u64 carry = 0;
+
+		if (!q[i])
+			continue;
+		for (j = 0; j < k && i + j <= k; j++) {
+			u128 acc = (u128)qm[i + j] + (u128)q[i] * m[j] + carry;
+
+			qm[i + j] = (u64)acc;
+			carry = (u64)(acc >> bit_sz_u64);
+		}
+		if (!i)
+			qm[k] = carry;
+	}
+
+	number_limbs_sub(r, k + 1, qm, k + 1);
+	for (;;) {
+		for (i = k; i >= 0 && r[i] == (i < k ? m[i] : 0); i--);
+		if (i >= 0 && r[i] < (i < k ? m[i] : 0))
+			break;
+
+		number_limbs_sub(r, k + 1, m, k);
+		number_limbs_add(q, k + 1, &one, 1);
+	}
+
+	for (i = 0; i <= block_sz_u1024; i++) {
+		*((u64*)&num_q->arr + i) = i <= k && i < block_sz_u1024 ?
+			q[i] : 0;
+		*((u64*)&num_r->arr + i) = i < k ? r[i] : 0;
+	}
+	number_top_set(num_q);
+	number_top_set(num_r);
+	TIMER_STOP(FUNC_NUMBER_BARRETT_DEV);
+}
+
 STATIC int INLINE number_modular_multiplication_naive(u1024_t *num_res,
 	u1024_t *num_a, u1024_t *num_b, u1024_t *num_n)
 {
@@ -362,15 +826,13 @@ STATIC int INLINE number_modular_multiplication_naive(u1024_t *num_res,
 static void INLINE number_init_random_strict_range(u1024_t *num_n,
 	u1024_t *range)
 {
-	u1024_t num_tmp, num_range_min1;
+	u1024_t num_range_min1;
 
 	TIMER_START(FUNC_NUMBER_INIT_RANDOM_STRICT_RANGE);
 	number_sub(&num_range_min1, range, &NUM_1);
-	number_init_random(&num_tmp, block_sz_u1024);
-	number_mod(&num_tmp, &num_tmp, &num_range_min1);
-	number_add(&num_tmp, &num_tmp, &NUM_1);
-
-	number_assign(*num_n, num_tmp);
+	number_init_random(num_n, block_sz_u1024);
+	number_mod(num_n, num_n, &num_range_min1);
+	number_add(num_n, num_n, &NUM_1);
 	TIMER_STOP(FUNC_NUMBER_INIT_RANDOM_STRICT_RANGE);
 }
 
@@ -392,23 +854,23 @@ STATIC void INLINE number_exponentiation(u1024_t *res, u1024_t *num_base,
 	TIMER_STOP(FUNC_NUMBER_EXPONENTIATION);
 }
 
-STATIC int INLINE number_modular_exponentiation_naive(u1024_t *res, u1024_t *a,
-	u1024_t *b, u1024_t *n)
+/* square and multiply, reducing by barrett division. the products must fit
+ * in a u1024_t, as with number_modular_multiplication_naive() */
+static void INLINE number_modular_exponentiation_barrett(u1024_t *res,
+	u1024_t *a, u1024_t *b, barrett_ctx_t *ctx)
 {
 	u1024_t d;
 	u64 *seg = NULL, mask;
 
-	TIMER_START(FUNC_NUMBER_MODULAR_EXPONENTIATION_NAIVE);
 	number_assign(d, NUM_1);
 	number_find_most_significant_set_bit(b, &seg, &mask);
 	while (seg >= (u64*)&b->arr) {
 		while (mask) {
-			if (number_modular_multiplication_naive(&d, &d, &d, n))
-				return -1;
-			if ((*seg & mask) &&
-				number_modular_multiplication_naive(&d, &d, a,
-				n)) {
-				return -1;
+			number_mul(&d, &d, &d);
+			number_barrett_mod(&d, &d, ctx);
+			if (*seg & mask) {
+				number_mul(&d, &d, a);
+				number_barrett_mod(&d, &d, ctx);
 			}
 
 			mask = mask >> 1;
@@ -417,195 +879,1165 @@ STATIC int INLINE number_modular_exponentiation_naive(u1024_t *res, u1024_t *a,
 		seg--;
 	}
 	number_assign(*res, d);
+}
+
+STATIC int INLINE number_modular_exponentiation_naive(u1024_t *res, u1024_t *a,
+	u1024_t *b, u1024_t *n)
+{
+	barrett_ctx_t ctx;
+
+	TIMER_START(FUNC_NUMBER_MODULAR_EXPONENTIATION_NAIVE);
+	number_barrett_ctx_init(&ctx, n);
+	number_modular_exponentiation_barrett(res, a, b, &ctx);
 	TIMER_STOP(FUNC_NUMBER_MODULAR_EXPONENTIATION_NAIVE);
 	return 0;
 }
 
-/* montgomery product
- * MonPro(a, b, n)
- *   s(-1) = 0
- *   a = 2a
- *   for i = 0 to n do
- *     q(i) = s(i-1) mod 2 (LSB of s(i-1))
- *     s(i) = (s(i-1) + q(i)n + b(i)a)/2
+/* n' = -n^(-1) mod 2^bit_sz_u64, where n is odd
+ * newton's iteration x = x(2 - nx) doubles the number of correct low bits of
+ * n^(-1) on each step. x = n is correct to 3 bits as n*n = 1 mod 8 */
+static u64 INLINE number_montgomery_n0inv(u1024_t *num_n)
+{
+	u64 n0 = *(u64*)&num_n->arr, x = n0;
+	int bits;
+
+	for (bits = 3; bits < bit_sz_u64; bits <<= 1)
+		x = (u64)(x * (u64)(2 - (u64)(n0 * x)));
+
+	return (u64)(0 - x);
+}
+
+/* res[0, k) = t[0, k] mod n, t < 2n. a single subtraction of n suffices, it is
+ * done on the way out to res */
+static NUMBER_KERNEL_INLINE void number_montgomery_final(u64 *res, u64 *t,
+	u64 *n, int k)
+{
+	int j;
+
+	for (j = k - 1; j >= 0 && t[j] == n[j]; j--);
+	if (t[k] || j < 0 || t[j] > n[j]) {
+		u64 borrow = 0;
+
+		for (j = 0; j < k; j++) {
+			u64 diff = (u64)(t[j] - n[j]);
+			u64 borrow_out = t[j] < n[j] || diff < borrow;
+
+			res[j] = (u64)(diff - borrow);
+			borrow = borrow_out;
+		}
+	}
+	else {
+		for (j = 0; j < k; j++)
+			res[j] = t[j];
+	}
+}
+
+/* montgomery product - coarsely integrated operand scanning (CIOS)
+ * r = 2^(bit_sz_u64 * k), w = 2^bit_sz_u64, k = block_sz_u1024
+ * MonPro(a, b, n) = abr^-1 mod n
+ *   t = 0
+ *   for i = 0 to k - 1 do
+ *     t = t + a * b[i]
+ *     m = t[0] * n' mod w
+ *     t = (t + m * n) / w
  *   end for
- *   return s(n)
- */
-static void INLINE number_montgomery_product(u1024_t *num_res, u1024_t *num_a,
-	u1024_t *num_b, u1024_t *num_n)
+ *   if t >= n then
+ *     t = t - n
+ *   end if
+ *   return t
+ *
+ * requires: a < n and b < r (or vice versa), in which case t < 2n before the
+ * final subtraction and the result is fully reduced.
+ * res[0, k) is written last, it may be a or b. the kernels below instantiate
+ * it for the k of each encryption level, unrolled at compile time */
+static NUMBER_KERNEL_INLINE void number_montgomery_cios(u64 *res, u64 *a,
+	u64 *b, u64 *n, u64 n0inv, int k)
+{
+	u64 t[RSA_NUMBER_ARRAY_SZ + 1];
+	int i, j;
+
+	for (j = 0; j < k + 2; j++)
+		t[j] = 0;
+
+	for (i = 0; i < k; i++) {
+		u128 acc;
+		u64 carry, m;
+
+		/* t = t + a * b[i] */
+		carry = 0;
+		NUMBER_KERNEL_UNROLL
+		for (j = 0; j < k; j++) {
+			acc = (u128)t[j] + (u128)a[j] * b[i] + carry;
+			t[j] = (u64)acc;
+			carry = (u64)(acc >> bit_sz_u64);
+		}
+		acc = (u128)t[k] + carry;
+		t[k] = (u64)acc;
+		t[k + 1] = (u64)(acc >> bit_sz_u64);
+
+		/* t = (t + m * n) / w */
+		m = (u64)(t[0] * n0inv);
+		acc = (u128)t[0] + (u128)m * n[0];
+		carry = (u64)(acc >> bit_sz_u64);
+		NUMBER_KERNEL_UNROLL
+		for (j = 1; j < k; j++) {
+			acc = (u128)t[j] + (u128)m * n[j] + carry;
+			t[j - 1] = (u64)acc;
+			carry = (u64)(acc >> bit_sz_u64);
+		}
+		acc = (u128)t[k] + carry;
+		t[k - 1] = (u64)acc;
+		t[k] = t[k + 1] + (u64)(acc >> bit_sz_u64);
+	}
+
+	number_montgomery_final(res, t, n, k);
+}
+
+#define NUMBER_KERNELS_DEFINE(K) \
+static void number_montgomery_product_##K(u64 *res, u64 *a, u64 *b, \
+	u64 *n, u64 n0inv) \
+{ \
+	number_montgomery_cios(res, a, b, n, n0inv, K); \
+}
+
+NUMBER_KERNELS_DEFINE(2)
+NUMBER_KERNELS_DEFINE(4)
+NUMBER_KERNELS_DEFINE(8)
+NUMBER_KERNELS_DEFINE(16)
+
+/* any k, such as that of half the 128 bit level (crt) or of the non ULLONG
+ * test builds */
+static void number_montgomery_product_generic(u64 *res, u64 *a, u64 *b,
+	u64 *n, u64 n0inv)
+{
+	number_montgomery_cios(res, a, b, n, n0inv, block_sz_u1024);
+}
+
+#ifdef NUMBER_KERNELS_ADX
+/* dst[0, k] = src[0, k] + a[0, k) * b, k > 0. returns the carry out of dst[k].
+ * the low halves of the products are added along the ADCX (CF) carry chain
+ * and the high halves along the ADOX (OF) one, so neither waits on the other.
+ * dst may be src or trail it */
+static u64 number_adx_mac(u64 *dst, u64 *src, u64 *a, u64 b, long k)
+{
+	u64 lo, hi, x, prev;
+
+	__asm__ __volatile__(
+		"xorl %k[prev], %k[prev]\n\t" /* clears CF and OF */
+		"1:\n\t"
+		"mulxq (%[a]), %[lo], %[hi]\n\t"
+		"movq (%[src]), %[x]\n\t"
+		"adcxq %[lo], %[x]\n\t"
+		"adoxq %[prev], %[x]\n\t"
+		"movq %[x], (%[dst])\n\t"
+		"movq %[hi], %[prev]\n\t"
+		/* lea and jrcxz leave the flags alone */
+		"leaq 8(%[a]), %[a]\n\t"
+		"leaq 8(%[src]), %[src]\n\t"
+		"leaq 8(%[dst]), %[dst]\n\t"
+		"leaq -1(%[k]), %[k]\n\t"
+		"jrcxz 2f\n\t"
+		"jmp 1b\n"
+		"2:\n\t"
+		"movq (%[src]), %[x]\n\t"
+		"movl $0, %k[lo]\n\t"
+		"adcxq %[lo], %[x]\n\t"
+		"adoxq %[prev], %[x]\n\t"
+		"movq %[x], (%[dst])\n\t"
+		/* lo = CF + OF */
+		"movl $0, %k[hi]\n\t"
+		"adcxq %[hi], %[lo]\n\t"
+		"adoxq %[hi], %[lo]\n\t"
+		: [dst] "+r" (dst), [src] "+r" (src), [a] "+r" (a),
+		  [k] "+c" (k), [lo] "=&r" (lo), [hi] "=&r" (hi),
+		  [x] "=&r" (x), [prev] "=&r" (prev)
+		: "d" (b)
+		: "cc", "memory");
+
+	return lo;
+}
+
+/* the CIOS montgomery product above, one row of the multiplication and one of
+ * the reduction per iteration. the reduction row is written a limb down, t[-1]
+ * takes its (zero) lowest limb */
+static void number_montgomery_product_adx(u64 *res, u64 *a, u64 *b, u64 *n,
+	u64 n0inv)
+{
+	u64 buf[RSA_NUMBER_ARRAY_SZ + 2], *t = buf + 1;
+	int i, j, k = block_sz_u1024;
+
+	for (j = 0; j < k + 2; j++)
+		t[j] = 0;
+
+	for (i = 0; i < k; i++) {
+		/* t = t + a * b[i] */
+		t[k + 1] = number_adx_mac(t, t, a, b[i], k);
+
+		/* t = (t + m * n) / w */
+		t[k] = t[k + 1] + number_adx_mac(t - 1, t, n,
+			(u64)(t[0] * n0inv), k);
+	}
+
+	number_montgomery_final(res, t, n, k);
+}
+
+/* res[0, 2*len) = a[0, len) * b[0, len) */
+static void number_mul_schoolbook_adx(u64 *res, u64 *a, u64 *b, int len)
 {
-	u1024_t multiplier, num_s;
-	u64 *seg = NULL, *top = (u64*)&num_b->arr + block_sz_u1024;
 	int i;
 
-	TIMER_START(FUNC_NUMBER_MONTGOMERY_PRODUCT);
-	number_assign(multiplier, *num_a);
-	number_assign(num_s, NUM_0);
-	number_shift_left_once(&multiplier);
-
-	/* handle the first 'encryption_level' iterations */
-	for (seg = (u64*)&num_b->arr; seg < top; seg++) {
-		u64 mask;
-
-		for (mask = (u64)1; mask; mask = mask << 1) {
-			if (number_is_odd(&num_s))
-				number_add(&num_s, &num_s, num_n);
-			if (*seg & mask)
-				number_add(&num_s, &num_s, &multiplier);
-			number_shift_right_once(&num_s);
+	for (i = 0; i < 2 * len; i++)
+		res[i] = 0;
+
+	for (i = 0; i < len; i++) {
+		if (a[i])
+			number_adx_mac(res + i, res + i, b, a[i], len);
+	}
+}
+
+/* at 2 limbs the unrolled portable montgomery product is the faster */
+static number_kernels_t number_kernels_adx[] = {
+	{ 2, number_montgomery_product_2, number_mul_schoolbook_adx },
+	{ 0, number_montgomery_product_adx, number_mul_schoolbook_adx },
+};
+#endif
+
+#ifdef NUMBER_KERNELS_IFMA
+/* d[0, l) = x[0, k) in 52 bit digits */
+static NUMBER_KERNEL_INLINE void number_ifma_digits(u64 *d, u64 *x, int k,
+	int l)
+{
+	int j;
+
+	NUMBER_KERNEL_UNROLL
+	for (j = 0; j < l; j++) {
+		int bit = j * NUMBER_IFMA_DIGIT, limb = bit / NUMBER_IFMA_LIMB,
+			off = bit % NUMBER_IFMA_LIMB;
+		u64 v = x[limb] >> off;
+
+		if (off > NUMBER_IFMA_LIMB - NUMBER_IFMA_DIGIT && limb + 1 < k)
+			v |= x[limb + 1] << (NUMBER_IFMA_LIMB - off);
+		d[j] = v & NUMBER_IFMA_MASK;
+	}
+}
+
+/* t[0, k] = d[0, l), carrying digits wider than 52 bits */
+static NUMBER_KERNEL_INLINE void number_ifma_limbs(u64 *t, u64 *d, int k,
+	int l)
+{
+	u64 carry = 0;
+	int j;
+
+	for (j = 0; j <= k; j++)
+		t[j] = 0;
+	NUMBER_KERNEL_UNROLL
+	for (j = 0; j < l; j++) {
+		int bit = j * NUMBER_IFMA_DIGIT, limb = bit / NUMBER_IFMA_LIMB,
+			off = bit % NUMBER_IFMA_LIMB;
+		u64 digit;
+
+		carry += d[j];
+		digit = carry & NUMBER_IFMA_MASK;
+		carry >>= NUMBER_IFMA_DIGIT;
+		t[limb] |= digit << off;
+		if (off > NUMBER_IFMA_LIMB - NUMBER_IFMA_DIGIT && limb < k)
+			t[limb + 1] |= digit >> (NUMBER_IFMA_LIMB - off);
+	}
+}
+
+/* the CIOS montgomery product above with 52 bit digits, 8 to a vector. each
+ * vector lane accumulates its digit's products and carries are only
+ * propagated at the end.
+ * r = 2^(64k) is not a power of the digit radix. the loop reduces by l - 1
+ * digits and the remaining e bits are reduced on the 64 bit limbs:
+ *   t = (ab + mn) / 2^(52(l - 1)) < (2^e + 1)n
+ *   t = (t + m'n) / 2^e < 2n */
+static NUMBER_IFMA_TARGET NUMBER_KERNEL_INLINE void number_montgomery_ifma(
+	u64 *res, u64 *a, u64 *b, u64 *n, u64 n0inv, int k)
+{
+	const int l = (k * NUMBER_IFMA_LIMB + NUMBER_IFMA_DIGIT - 1) /
+		NUMBER_IFMA_DIGIT;
+	const int nv = (l + 1 + 7) / 8;
+	const int e = k * NUMBER_IFMA_LIMB - (l - 1) * NUMBER_IFMA_DIGIT;
+	u64 a52[8 * NUMBER_IFMA_VECTORS + 1] = { 0 };
+	u64 n52[8 * NUMBER_IFMA_VECTORS + 1] = { 0 };
+	u64 b52[8 * NUMBER_IFMA_VECTORS], t[RSA_NUMBER_ARRAY_SZ + 1];
+	u64 *d = a52, carry, m;
+	__m512i acc[NUMBER_IFMA_VECTORS], va[NUMBER_IFMA_VECTORS];
+	__m512i vn[NUMBER_IFMA_VECTORS], vn_down[NUMBER_IFMA_VECTORS];
+	__m512i zero = _mm512_setzero_si512();
+	int i, j, v;
+
+	number_ifma_digits(a52, a, k, l);
+	number_ifma_digits(b52, b, k, l);
+	number_ifma_digits(n52, n, k, l);
+	for (v = 0; v < nv; v++) {
+		acc[v] = zero;
+		va[v] = _mm512_loadu_si512(a52 + 8 * v);
+		vn[v] = _mm512_loadu_si512(n52 + 8 * v);
+		/* digit j + 1 of n in lane j */
+		vn_down[v] = _mm512_loadu_si512(n52 + 8 * v + 1);
+	}
+
+	for (i = 0; i < l; i++) {
+		__m512i vb = _mm512_set1_epi64(b52[i]), vm;
+
+		/* t = t + a * b[i], low halves */
+		for (v = 0; v < nv; v++)
+			acc[v] = _mm512_madd52lo_epu64(acc[v], va[v], vb);
+
+		if (i == l - 1) {
+			__m512i hi[NUMBER_IFMA_VECTORS];
+
+			/* no reduction, the high halves go a digit up */
+			for (v = 0; v < nv; v++) {
+				hi[v] = _mm512_madd52hi_epu64(zero, va[v], vb);
+				acc[v] = _mm512_add_epi64(acc[v],
+					_mm512_alignr_epi64(hi[v],
+					v ? hi[v - 1] : zero, 7));
+			}
+			break;
+		}
+
+		/* t = (t + m * n) / w, w = 2^52. t is shifted a digit down
+		 * while m is calculated and m * n is added shifted */
+		carry = _mm_cvtsi128_si64(_mm512_castsi512_si128(acc[0]));
+		for (v = 0; v < nv; v++) {
+			acc[v] = _mm512_alignr_epi64(v + 1 < nv ? acc[v + 1] :
+				zero, acc[v], 1);
+		}
+		for (v = 0; v < nv; v++)
+			acc[v] = _mm512_madd52hi_epu64(acc[v], va[v], vb);
+		m = (carry * n0inv) & NUMBER_IFMA_MASK;
+		carry = (carry + ((m * n52[0]) & NUMBER_IFMA_MASK)) >>
+			NUMBER_IFMA_DIGIT;
+		vm = _mm512_set1_epi64(m);
+		acc[0] = _mm512_add_epi64(acc[0],
+			_mm512_zextsi128_si512(_mm_cvtsi64_si128(carry)));
+		for (v = 0; v < nv; v++) {
+			acc[v] = _mm512_madd52lo_epu64(acc[v], vn_down[v], vm);
+			acc[v] = _mm512_madd52hi_epu64(acc[v], vn[v], vm);
 		}
 	}
 
-	/* handle extra 2 iterations, as buffer size is is considered to be
-	 * MAX(bit_sz) + 2. */
-	for (i = 0 ;i < 3; i++) {
-		if (number_is_odd(&num_s))
-			number_add(&num_s, &num_s, num_n);
-		/* the two overflow bits of num_b are zero */
-		number_shift_right_once(&num_s);
+	for (v = 0; v < nv; v++)
+		_mm512_storeu_si512(d + 8 * v, acc[v]);
+	number_ifma_limbs(t, d, k, l + 1);
+
+	/* t = (t + m' * n) / 2^e, m' = t[0] * n' mod 2^e */
+	m = (t[0] * n0inv) & (((u64)1 << e) - 1);
+	carry = 0;
+	NUMBER_KERNEL_UNROLL
+	for (j = 0; j < k; j++) {
+		u128 acc = (u128)t[j] + (u128)m * n[j] + carry;
+
+		t[j] = (u64)acc;
+		carry = (u64)(acc >> NUMBER_IFMA_LIMB);
 	}
+	t[k] += carry;
+	NUMBER_KERNEL_UNROLL
+	for (j = 0; j < k; j++)
+		t[j] = (t[j] >> e) | (t[j + 1] << (NUMBER_IFMA_LIMB - e));
+	t[k] >>= e;
 
-	number_assign(*num_res, num_s);
-	TIMER_STOP(FUNC_NUMBER_MONTGOMERY_PRODUCT);
+	number_montgomery_final(res, t, n, k);
 }
 
-/* shift left and do mod num_n 2*(encryption_level + 2) times... */
-void INLINE number_montgomery_factor_set(u1024_t *num_n, u1024_t *num_factor)
+static NUMBER_IFMA_TARGET void number_montgomery_product_ifma_16(u64 *res,
+	u64 *a, u64 *b, u64 *n, u64 n0inv)
 {
-	u1024_t factor;
-	int exp, exp_max;
-	u64 *buffer;
+	number_montgomery_ifma(res, a, b, n, n0inv, 16);
+}
 
-	TIMER_START(FUNC_NUMBER_MONTGOMERY_FACTOR_SET);
-	if (number_is_equal(&num_montgomery_n, num_n))
-		return;
+static void number_montgomery_exponentiation_lanes_2(u1024_t **res,
+	u1024_t **a, int num, u1024_t *b, montgomery_ctx_t *ctx);
+static void number_montgomery_exponentiation_lanes_4(u1024_t **res,
+	u1024_t **a, int num, u1024_t *b, montgomery_ctx_t *ctx);
+static void number_montgomery_exponentiation_lanes_8(u1024_t **res,
+	u1024_t **a, int num, u1024_t *b, montgomery_ctx_t *ctx);
+static void number_montgomery_exponentiation_lanes_16(u1024_t **res,
+	u1024_t **a, int num, u1024_t *b, montgomery_ctx_t *ctx);
+
+/* the ADX kernels, but for 16 limbs. at fewer limbs the latency of the
+ * digit by digit reduction outweighs the wider multiplication */
+static number_kernels_t number_kernels_ifma[] = {
+	{ 2, number_montgomery_product_2, number_mul_schoolbook_adx,
+		number_montgomery_exponentiation_lanes_2 },
+	{ 4, number_montgomery_product_adx, number_mul_schoolbook_adx,
+		number_montgomery_exponentiation_lanes_4 },
+	{ 8, number_montgomery_product_adx, number_mul_schoolbook_adx,
+		number_montgomery_exponentiation_lanes_8 },
+	{ 16, number_montgomery_product_ifma_16, number_mul_schoolbook_adx,
+		number_montgomery_exponentiation_lanes_16 },
+	{ 0, number_montgomery_product_adx, number_mul_schoolbook_adx },
+};
+#endif
+
+/* kernels per block size, the last of which is the generic one. the thread's
+ * kernels are selected whenever block_sz_u1024 changes */
+static number_kernels_t number_kernels[] = {
+	{ 2, number_montgomery_product_2, number_mul_schoolbook },
+	{ 4, number_montgomery_product_4, number_mul_schoolbook },
+	{ 8, number_montgomery_product_8, number_mul_schoolbook },
+	{ 16, number_montgomery_product_16, number_mul_schoolbook },
+	{ 0, number_montgomery_product_generic, number_mul_schoolbook },
+};
+
+#ifdef NUMBER_KERNELS_ADX
+static int number_cpu_has_adx(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return (ebx & bit_BMI2) && (ebx & bit_ADX);
+}
+#endif
 
-	if (num_factor)
+#ifdef NUMBER_KERNELS_IFMA
+/* the os must save the avx-512 state as well, which __builtin_cpu_supports()
+ * checks */
+static int number_cpu_has_ifma(void)
+{
+	__builtin_cpu_init();
+	return number_cpu_has_adx() && __builtin_cpu_supports("avx512ifma");
+}
+#endif
+
+static int number_cpu_any(void)
+{
+	return 1;
+}
+
+/* arithmetic backends, in order of preference. a backend is a kernel table
+ * driving the montgomery products of modular multiplication and
+ * exponentiation, the base case of multiplication and multi block
+ * exponentiation. division and the karatsuba recursion are shared */
+typedef struct {
+	char *name;
+	char *desc;
+	number_kernels_t *kernels;
+	int (*is_supported)(void);
+} number_backend_t;
+
+static number_backend_t number_backends[] = {
+	{ "portable", "word by word products, any cpu", number_kernels,
+		number_cpu_any },
+#ifdef NUMBER_KERNELS_ADX
+	{ "adx", "mulx/adcx/adox products (bmi2 and adx)", number_kernels_adx,
+		number_cpu_has_adx },
+#endif
+#ifdef NUMBER_KERNELS_IFMA
+	{ "ifma", "2^52 radix products and multi block exponentiation "
+		"(avx-512 ifma)", number_kernels_ifma, number_cpu_has_ifma },
+#endif
+	{ NULL }
+};
+
+/* the backend in use, process wide */
+static number_backend_t *number_backend = number_backends;
+
+static __thread number_kernels_t *number_kernel =
+	&number_kernels[ARRAY_SZ(number_kernels) - 1];
+
+static void number_kernels_select(void)
+{
+	for (number_kernel = number_backend->kernels; number_kernel->block_sz &&
+		number_kernel->block_sz != block_sz_u1024; number_kernel++);
+}
+
+/* the name and description of the idx'th backend and whether the cpu supports
+ * it. NULL past the last backend */
+char *number_backend_name(int idx, char **desc, int *is_supported)
+{
+	if (idx < 0 || idx >= ARRAY_SZ(number_backends) - 1)
+		return NULL;
+
+	if (desc)
+		*desc = number_backends[idx].desc;
+	if (is_supported)
+		*is_supported = number_backends[idx].is_supported();
+	return number_backends[idx].name;
+}
+
+/* use the named backend, or the most preferred one the cpu supports if name
+ * is NULL. the calling thread switches over at once, others on their next
+ * change of encryption level. returns -1 if name is not a backend the cpu
+ * supports */
+int number_backend_set(char *name)
+{
+	number_backend_t *backend, *found = NULL;
+
+	for (backend = number_backends; backend->name; backend++) {
+		if ((!name || !strcmp(name, backend->name)) &&
+			backend->is_supported()) {
+			found = backend;
+		}
+	}
+	if (!found)
+		return -1;
+
+	number_backend = found;
+	number_kernels_select();
+	return 0;
+}
+
+char *number_backend_get(void)
+{
+	return number_backend->name;
+}
+
+static void __attribute__((constructor)) number_kernels_init(void)
+{
+	number_backend_set(NULL);
+}
+
+static void INLINE number_montgomery_product(u1024_t *num_res, u1024_t *num_a,
+	u1024_t *num_b, montgomery_ctx_t *ctx)
+{
+	TIMER_START(FUNC_NUMBER_MONTGOMERY_PRODUCT);
+	number_kernel->montgomery_product((u64*)&num_res->arr,
+		(u64*)&num_a->arr, (u64*)&num_b->arr, (u64*)&ctx->n.arr,
+		ctx->n0inv);
+	*((u64*)&num_res->arr + block_sz_u1024) = 0;
+	number_top_set(num_res);
+	TIMER_STOP(FUNC_NUMBER_MONTGOMERY_PRODUCT);
+}
+
+/* x = 2x mod n, 0 <= x < n */
+static void INLINE number_montgomery_double(u1024_t *x, u1024_t *n)
+{
+	number_shift_left_once(x);
+	if (number_is_greater_or_equal(x, n))
+		number_sub(x, x, n);
+}
+
+/* set up a montgomery context for the odd modulus n at the current encryption
+ * level, r = 2^encryption_level.
+ * factor, if given, is of the key file format: 2^(2*(encryption_level+2)) mod
+ * n, and r^2 mod n is derived from it by halving it 4 times modulo n.
+ * otherwise, r^2 mod n is set up at the word level, which is cheap enough for
+ * short lived moduli such as prime candidates:
+ *   x = r mod n = (r - n) mod n (a single division)
+ *   x = 2^e * r mod n (e doublings)
+ *   x = MonPro(x, x, n) = 2^2e * r mod n (s squarings)
+ * where e * 2^s = encryption_level, leaving x = r^2 mod n */
+void INLINE number_montgomery_ctx_init(montgomery_ctx_t *ctx, u1024_t *num_n,
+	u1024_t *num_factor)
+{
+	int i, e, s;
+
+	TIMER_START(FUNC_NUMBER_MONTGOMERY_CTX_INIT);
+	number_assign(ctx->n, *num_n);
+	ctx->n0inv = number_montgomery_n0inv(num_n);
+
+	if (num_factor) {
+		/* r^2 = 2^(2*(encryption_level+2)) / 2^4 mod n */
+		number_assign(ctx->rr, *num_factor);
+		for (i = 0; i < 4; i++) {
+			if (number_is_odd(&ctx->rr))
+				number_add(&ctx->rr, &ctx->rr, num_n);
+			number_shift_right_once(&ctx->rr);
+		}
+		number_montgomery_product(&ctx->r, &ctx->rr, &NUM_1, ctx);
 		goto Exit;
-	num_factor = &factor;
+	}
+
+	number_sub(&ctx->rr, &NUM_0, num_n);
+	number_mod(&ctx->r, &ctx->rr, num_n);
+
+	for (e = encryption_level, s = 0;
+		e > NUMBER_MONTGOMERY_CTX_DOUBLINGS && !(e & 1); e >>= 1, s++);
+	number_assign(ctx->rr, ctx->r);
+	for (i = 0; i < e; i++)
+		number_montgomery_double(&ctx->rr, num_n);
+	for (i = 0; i < s; i++)
+		number_montgomery_product(&ctx->rr, &ctx->rr, &ctx->rr, ctx);
+
+Exit:
+	TIMER_STOP(FUNC_NUMBER_MONTGOMERY_CTX_INIT);
+}
 
-	exp_max = 2*(encryption_level+2);
-	number_small_dec2num(num_factor, (u64)1);
-	exp = 0;
-	buffer = (u64*)num_factor->arr + block_sz_u1024;
+/* the key file format factor: 2^(2*(encryption_level+2)) mod n = 2^4 * r^2
+ * mod n */
+void INLINE number_montgomery_ctx_factor_get(montgomery_ctx_t *ctx,
+	u1024_t *num_factor)
+{
+	int i;
+
+	number_assign(*num_factor, ctx->rr);
+	for (i = 0; i < 4; i++)
+		number_montgomery_double(num_factor, &ctx->n);
+}
+
+/* a: exponent
+ * b: power
+ * n: modulus
+ * r: 2^(encryption_level)%n
+ * MonPro(a, b, n) = abr^-1%n
+ *
+ * a * b % n = arr^-1br^-1%n = MonPro(ar%n, b, n) =
+ *             MonPro(MonPro(a, r^2%n, n), b, n)
+ *
+ * ctx.rr = r^2%n = 2^2BIT_SZ(u1024_t)%n
+ * a_tmp = MonPro(a, r^2%n, n) < n, so both products are fully reduced for any
+ * a, b < r
+ */
+STATIC int INLINE number_modular_multiplication_montgomery(u1024_t *num_res,
+	u1024_t *num_a, u1024_t *num_b, u1024_t *num_n)
+{
+	int ret;
+	u1024_t a_tmp;
+	montgomery_ctx_t ctx;
+
+	TIMER_START(FUNC_NUMBER_MODULAR_MULTIPLICATION_MONTGOMERY);
+	number_montgomery_ctx_init(&ctx, num_n, NULL);
+
+	number_montgomery_product(&a_tmp, num_a, &ctx.rr, &ctx);
+	number_montgomery_product(num_res, &a_tmp, num_b, &ctx);
+	ret = 0;
+
+	TIMER_STOP(FUNC_NUMBER_MODULAR_MULTIPLICATION_MONTGOMERY);
+	return ret;
+}
+
+/* number of significant bits in num (0 for num == 0) */
+static int INLINE number_bit_length(u1024_t *num)
+{
+	u64 *seg, mask;
+	int bits;
+
+	for (seg = (u64*)&num->arr + block_sz_u1024 - 1;
+		seg > (u64*)&num->arr && !*seg; seg--);
+	bits = (seg - (u64*)&num->arr) * bit_sz_u64;
+	for (mask = *seg; mask; mask = mask >> 1)
+		bits++;
+
+	return bits;
+}
+
+/* sliding window width per encryption level. the odd power table holds
+ * 2^(width-1) entries */
+static int INLINE number_exponentiation_window_width(int exp_bits)
+{
+	code2code_t widths[] = {
+		{128, 4},
+		{256, 4},
+		{512, 5},
+		{1024, NUMBER_EXPONENTIATION_WINDOW_MAX},
+		{-1}
+	};
+	int width = code2code(widths, encryption_level);
+
+	/* short exponents, such as F4 (65537), are mostly sparse: plain
+	 * square and multiply, with no odd power table to set up */
+	if (width < 1 || exp_bits <= NUMBER_EXPONENTIATION_SHORT)
+		return 1;
+
+	/* short exponents do not justify a large odd power table */
+	while (width > 1 && (1 << width) > exp_bits)
+		width--;
+
+	return width;
+}
+
+/* montgomery (left-right, sliding window) modular exponentiation procedure:
+ * MonExp(a, b, n)
+ *   c = 2^(2n)
+ *   g[0] = MonPro(c, a, n) (mapping)
+ *   g2 = MonPro(g[0], g[0], n)
+ *   for i = 1 to 2^(k-1) - 1 do
+ *     g[i] = MonPro(g[i-1], g2, n) (odd powers: a^(2i+1))
+ *   end for
+ *   r = MonPro(c, 1, n)
+ *   i = t-1 (most significant set bit of b)
+ *   while i >= 0 do
+ *     if (bi==0) then
+ *       r = MonPro(r, r, n) (square)
+ *       i = i-1
+ *     else
+ *       find the longest bit string bi...bl such that i-l+1 <= k and bl==1
+ *       r = r^(2^(i-l+1)) (square i-l+1 times)
+ *       r = MonPro(r, g[(bi...bl - 1)/2], n) (multiply)
+ *       i = l-1
+ *     end if
+ *   end while
+ *   r = MonPro(1, r, n)
+ *   return r
+ */
+int INLINE number_montgomery_exponentiation(u1024_t *res, u1024_t *a,
+	u1024_t *b, montgomery_ctx_t *ctx)
+{
+	u1024_t odd_powers[1 << (NUMBER_EXPONENTIATION_WINDOW_MAX - 1)];
+	u1024_t a_nresidue_sqr, acc;
+	int i, bits, width, is_first = 1, ret = 0;
+
+	TIMER_START(FUNC_NUMBER_MODULAR_EXPONENTIATION_MONTGOMERY);
+	bits = number_bit_length(b);
+	width = number_exponentiation_window_width(bits);
+
+	/* odd power table */
+	number_montgomery_product(&odd_powers[0], a, &ctx->rr, ctx);
+	if (width > 1) {
+		number_montgomery_product(&a_nresidue_sqr, &odd_powers[0],
+			&odd_powers[0], ctx);
+	}
+	for (i = 1; i < 1 << (width - 1); i++) {
+		number_montgomery_product(&odd_powers[i], &odd_powers[i - 1],
+			&a_nresidue_sqr, ctx);
+	}
+
+	number_assign(acc, ctx->r);
+	for (i = bits - 1; i >= 0; ) {
+		int l, j, window;
+
+		if (!NUMBER_BIT(b, i)) {
+			number_montgomery_product(&acc, &acc, &acc, ctx);
+			i--;
+			continue;
+		}
+
+		/* bits i...l, bl == 1 */
+		for (l = i - width + 1 < 0 ? 0 : i - width + 1;
+			!NUMBER_BIT(b, l); l++);
+		for (window = 0, j = i; j >= l; j--)
+			window = (window << 1) | NUMBER_BIT(b, j);
+
+		if (is_first) {
+			/* acc == 1, squaring it is superfluous */
+			number_assign(acc, odd_powers[window >> 1]);
+			is_first = 0;
+		}
+		else {
+			for (j = i; j >= l; j--)
+				number_montgomery_product(&acc, &acc, &acc,
+					ctx);
+			number_montgomery_product(&acc, &acc,
+				&odd_powers[window >> 1], ctx);
+		}
+		i = l - 1;
+	}
+	number_montgomery_product(res, &NUM_1, &acc, ctx);
+
+	TIMER_STOP(FUNC_NUMBER_MODULAR_EXPONENTIATION_MONTGOMERY);
+	return ret;
+}
+
+#ifdef NUMBER_KERNELS_IFMA
+/* montgomery product of NUMBER_LANES numbers at once, each in a vector lane.
+ * the numbers are stored structure of arrays: digit j of all lanes is the
+ * j'th vector. with r' = 2^(52l) >= 4n, operands and results < 2n need no
+ * final subtraction (almost montgomery multiplication) */
+static NUMBER_IFMA_TARGET NUMBER_KERNEL_INLINE void number_lanes_product_l(
+	__m512i *res, __m512i *a, __m512i *b, __m512i *n, __m512i n0inv, int l)
+{
+	__m512i t[2 * NUMBER_IFMA_DIGITS], zero = _mm512_setzero_si512();
+	__m512i mask = _mm512_set1_epi64(NUMBER_IFMA_MASK);
+	int i, j;
+
+	for (j = 0; j < 2 * l; j++)
+		t[j] = zero;
+
+	for (i = 0; i < l; i++) {
+		__m512i m;
+
+		/* t = t + a * b[i] */
+		NUMBER_LANES_UNROLL
+		for (j = 0; j < l; j++) {
+			t[i + j] = _mm512_madd52lo_epu64(t[i + j], a[j], b[i]);
+			t[i + j + 1] = _mm512_madd52hi_epu64(t[i + j + 1], a[j],
+				b[i]);
+		}
+
+		/* t = t + m * n, digit i becomes 0 mod 2^52 */
+		m = _mm512_madd52lo_epu64(zero, t[i], n0inv);
+		NUMBER_LANES_UNROLL
+		for (j = 0; j < l; j++) {
+			t[i + j] = _mm512_madd52lo_epu64(t[i + j], n[j], m);
+			t[i + j + 1] = _mm512_madd52hi_epu64(t[i + j + 1], n[j],
+				m);
+		}
+		t[i + 1] = _mm512_add_epi64(t[i + 1],
+			_mm512_srli_epi64(t[i], NUMBER_IFMA_DIGIT));
+	}
+
+	/* res = t / r' */
+	for (j = 0; j < l; j++) {
+		if (j + 1 < l) {
+			t[l + j + 1] = _mm512_add_epi64(t[l + j + 1],
+				_mm512_srli_epi64(t[l + j], NUMBER_IFMA_DIGIT));
+		}
+		res[j] = _mm512_and_si512(t[l + j], mask);
+	}
+}
+
+typedef void (*number_lanes_product_t)(__m512i *res, __m512i *a, __m512i *b,
+	__m512i *n, __m512i n0inv);
+
+/* res[i] = a[i]^b mod n, i < num <= NUMBER_LANES. lanes from num on repeat
+ * a[0]. the exponentiation follows number_montgomery_exponentiation(), in
+ * the lanes' own n-residue domain: r' = 2^(52l) = r * 2^e, and
+ * r'^2 mod n = (r^2 mod n) * 2^(2e) mod n */
+static NUMBER_IFMA_TARGET NUMBER_KERNEL_INLINE void
+	number_montgomery_exponentiation_lanes(u1024_t **res, u1024_t **a,
+	int num, u1024_t *b, montgomery_ctx_t *ctx, int k,
+	number_lanes_product_t number_lanes_product)
+{
+	const int l = (k * NUMBER_IFMA_LIMB + NUMBER_IFMA_DIGIT - 1) /
+		NUMBER_IFMA_DIGIT;
+	const int e = l * NUMBER_IFMA_DIGIT - k * NUMBER_IFMA_LIMB;
+	__m512i odd_powers[1 << (NUMBER_EXPONENTIATION_WINDOW_MAX - 1)]
+		[NUMBER_IFMA_DIGITS];
+	__m512i n[NUMBER_IFMA_DIGITS], rr[NUMBER_IFMA_DIGITS];
+	__m512i one[NUMBER_IFMA_DIGITS], acc[NUMBER_IFMA_DIGITS];
+	__m512i sqr[NUMBER_IFMA_DIGITS], n0inv;
+	u64 d[NUMBER_IFMA_DIGITS][NUMBER_LANES], t[RSA_NUMBER_ARRAY_SZ + 1];
+	u64 digits[NUMBER_IFMA_DIGITS], *nl = (u64*)&ctx->n.arr;
+	int i, j, lane, bits, width, is_first = 1;
+
+	/* r'^2 mod n, doubled on the 64 bit limbs */
+	for (j = 0; j < k; j++)
+		t[j] = *((u64*)&ctx->rr.arr + j);
+	for (i = 0; i < 2 * e; i++) {
+		t[k] = t[k - 1] >> (NUMBER_IFMA_LIMB - 1);
+		for (j = k - 1; j > 0; j--)
+			t[j] = (t[j] << 1) |
+				(t[j - 1] >> (NUMBER_IFMA_LIMB - 1));
+		t[0] <<= 1;
+		number_montgomery_final(t, t, nl, k);
+	}
+	number_ifma_digits(digits, t, k, l);
+	for (j = 0; j < l; j++)
+		rr[j] = _mm512_set1_epi64(digits[j]);
+	number_ifma_digits(digits, nl, k, l);
+	for (j = 0; j < l; j++) {
+		n[j] = _mm512_set1_epi64(digits[j]);
+		one[j] = _mm512_set1_epi64(!j);
+	}
+	n0inv = _mm512_set1_epi64(ctx->n0inv & NUMBER_IFMA_MASK);
+
+	/* a, transposed into digit vectors */
+	for (lane = 0; lane < NUMBER_LANES; lane++) {
+		number_ifma_digits(digits, (u64*)&a[lane < num ? lane : 0]->arr,
+			k, l);
+		for (j = 0; j < l; j++)
+			d[j][lane] = digits[j];
+	}
+	for (j = 0; j < l; j++)
+		acc[j] = _mm512_loadu_si512(d[j]);
+
+	/* odd power table */
+	bits = number_bit_length(b);
+	width = number_exponentiation_window_width(bits);
+	number_lanes_product(odd_powers[0], acc, rr, n, n0inv);
+	if (width > 1) {
+		number_lanes_product(sqr, odd_powers[0], odd_powers[0], n,
+			n0inv);
+	}
+	for (i = 1; i < 1 << (width - 1); i++) {
+		number_lanes_product(odd_powers[i], odd_powers[i - 1], sqr, n,
+			n0inv);
+	}
+
+	for (i = bits - 1; i >= 0; ) {
+		int w, window;
+
+		if (!NUMBER_BIT(b, i)) {
+			number_lanes_product(acc, acc, acc, n, n0inv);
+			i--;
+			continue;
+		}
+
+		/* bits i...w, bw == 1 */
+		for (w = i - width + 1 < 0 ? 0 : i - width + 1;
+			!NUMBER_BIT(b, w); w++);
+		for (window = 0, j = i; j >= w; j--)
+			window = (window << 1) | NUMBER_BIT(b, j);
+
+		if (is_first) {
+			for (j = 0; j < l; j++)
+				acc[j] = odd_powers[window >> 1][j];
+			is_first = 0;
+		}
+		else {
+			for (j = i; j >= w; j--)
+				number_lanes_product(acc, acc, acc, n, n0inv);
+			number_lanes_product(acc, acc, odd_powers[window >> 1],
+				n, n0inv);
+		}
+		i = w - 1;
+	}
+	/* b == 0 */
+	if (is_first)
+		number_lanes_product(acc, one, rr, n, n0inv);
+	number_lanes_product(acc, acc, one, n, n0inv);
+
+	/* back to 64 bit limbs, acc <= n */
+	for (j = 0; j < l; j++)
+		_mm512_storeu_si512(d[j], acc[j]);
+	for (lane = 0; lane < num; lane++) {
+		u64 *r = (u64*)&res[lane]->arr;
+
+		for (j = 0; j < l; j++)
+			digits[j] = d[j][lane];
+		number_ifma_limbs(t, digits, k, l);
+		number_montgomery_final(r, t, nl, k);
+		for (j = k; j < block_sz_u1024 + 1; j++)
+			r[j] = 0;
+		number_top_set(res[lane]);
+	}
+}
+
+#define NUMBER_LANES_DEFINE(K) \
+static NUMBER_IFMA_TARGET void number_lanes_product_##K(__m512i *res, \
+	__m512i *a, __m512i *b, __m512i *n, __m512i n0inv) \
+{ \
+	number_lanes_product_l(res, a, b, n, n0inv, \
+		(K * NUMBER_IFMA_LIMB + NUMBER_IFMA_DIGIT - 1) / \
+		NUMBER_IFMA_DIGIT); \
+} \
+static NUMBER_IFMA_TARGET void number_montgomery_exponentiation_lanes_##K( \
+	u1024_t **res, u1024_t **a, int num, u1024_t *b, \
+	montgomery_ctx_t *ctx) \
+{ \
+	number_montgomery_exponentiation_lanes(res, a, num, b, ctx, K, \
+		number_lanes_product_##K); \
+}
+
+NUMBER_LANES_DEFINE(2)
+NUMBER_LANES_DEFINE(4)
+NUMBER_LANES_DEFINE(8)
+NUMBER_LANES_DEFINE(16)
+#endif
+
+/* res[i] = a[i]^b mod n, i < num. the numbers are exponentiated NUMBER_LANES
+ * at a time if the cpu's kernels can, one after the other otherwise. res[i]
+ * may be a[i] */
+int number_montgomery_exponentiation_batch(u1024_t **res, u1024_t **a,
+	int num, u1024_t *b, montgomery_ctx_t *ctx)
+{
+	int i, lanes;
+
+	for (i = 0; i < num; i += lanes) {
+		lanes = num - i < NUMBER_LANES ? num - i : NUMBER_LANES;
+		if (!number_kernel->montgomery_exponentiation_lanes ||
+			lanes < NUMBER_LANES_MIN) {
+			number_montgomery_exponentiation(res[i], a[i], b, ctx);
+			lanes = 1;
+			continue;
+		}
+
+		number_kernel->montgomery_exponentiation_lanes(res + i, a + i,
+			lanes, b, ctx);
+	}
+
+	return 0;
+}
+
+/* callers exponentiating repeatedly modulo the same n should set up a
+ * montgomery context once and use number_montgomery_exponentiation() */
+int number_modular_exponentiation_montgomery(u1024_t *res, u1024_t *a,
+	u1024_t *b, u1024_t *n)
+{
+	montgomery_ctx_t ctx;
 
-	while (exp < exp_max) {
-		while (!*buffer && number_is_greater(num_n, num_factor)) {
-			if (exp == exp_max)
-				goto Exit;
-			number_shift_left_once(num_factor);
-			exp++;
-		}
-		number_sub(num_factor, num_factor, num_n);
-	}
+	number_montgomery_ctx_init(&ctx, n, NULL);
+	return number_montgomery_exponentiation(res, a, b, &ctx);
+}
 
-Exit:
-	number_assign(num_montgomery_factor, *num_factor);
-	number_assign(num_montgomery_n, *num_n);
-	number_montgomery_product(&num_res_nresidue, &num_montgomery_factor,
-		&NUM_1, num_n);
-	TIMER_START(FUNC_NUMBER_MONTGOMERY_FACTOR_SET);
+/* crt moduli are half the encryption level wide. the level is switched
+ * directly as half of 128 bits is not an encryption level of its own.
+ * montgomery contexts set up at one level must not be used at the other */
+static void INLINE number_enclevl_halve(void)
+{
+	encryption_level >>= 1;
+	block_sz_u1024 >>= 1;
+	number_kernels_select();
 }
 
-void INLINE number_montgomery_factor_get(u1024_t *num)
+static void INLINE number_enclevl_double(void)
 {
-	number_assign(*num, num_montgomery_factor);
+	encryption_level <<= 1;
+	block_sz_u1024 <<= 1;
+	number_kernels_select();
 }
 
-/* a: exponent
- * b: power
- * n: modulus
- * r: 2^(encryption_level)%n
- * MonPro(a, b, n) = abr^-1%n
- *
- * a * b % n = abrr^-1%n = 1abrr^-1%n = MonPro(1, abr%n, n) =
- *             MonPro(1, arbrr^-1%n, n) = MonPro(1, ar%n*br%n*r^-1, n) =
- *             MonPro(1, a(r^2)(r^-1)%n * b(r^2)(r^-1) * (r^-1), n) =
- *             MonPro(1, MonPro(a(r^2)(r^-1)%n, b(r^2)(r^-1), n), n) =
- *             MonPro(1, MonPro(MonPro(a, r^2%n, n), MonPro(b, r^2%n, n), n), n)
- *
- * num_montgomery_factor = r^2%n = 2^2BIT_SZ(u1024_t)%n
- * a_tmp = MonPro(a, r^2%n, n)
- * b_tmp = MonPro(b, r^2%n, n)
- * a * b % n = MonPro(1, MonPro(a_tmp, b_tmp, n), n)
+/* at half the encryption level, with r = 2^encryption_level:
+ * a = a_hi*r + a_lo
+ * a mod p = (MonPro(a_hi, r^2%p, p) + MonPro(MonPro(a_lo, r^2%p, p), 1, p))
+ *   mod p
  */
-STATIC int INLINE number_modular_multiplication_montgomery(u1024_t *num_res,
-	u1024_t *num_a, u1024_t *num_b, u1024_t *num_n)
+static void INLINE number_crt_reduce(u1024_t *res, u1024_t *a_hi,
+	u1024_t *a_lo, montgomery_ctx_t *p)
 {
-	int ret;
-	u1024_t a_tmp, b_tmp;
+	u1024_t lo;
+
+	number_montgomery_product(res, a_hi, &p->rr, p);
+	number_montgomery_product(&lo, a_lo, &p->rr, p);
+	number_montgomery_product(&lo, &NUM_1, &lo, p);
+	number_add(res, res, &lo);
+	if (number_is_greater_or_equal(res, &p->n))
+		number_sub(res, res, &p->n);
+}
 
-	TIMER_START(FUNC_NUMBER_MODULAR_MULTIPLICATION_MONTGOMERY);
-	number_montgomery_factor_set(num_n, NULL);
+/* returns -1 if p or q are wider than half the encryption level, in which case
+ * crt->p is reset */
+int number_crt_key_init(crt_key_t *crt, u1024_t *p, u1024_t *q, u1024_t *d)
+{
+	u1024_t p_min1, q_min1, q_mod_p;
+	montgomery_ctx_t ctx;
+	int half = block_sz_u1024 >> 1;
+
+	number_reset(&crt->p);
+	number_reset(&crt->q);
+	number_reset(&crt->dp);
+	number_reset(&crt->dq);
+	number_reset(&crt->qinv);
+	number_reset(&crt->factor_p);
+	number_reset(&crt->factor_q);
+
+	if (p->top >= half || q->top >= half)
+		return -1;
 
-	number_montgomery_product(&a_tmp, num_a, &num_montgomery_factor, num_n);
-	number_montgomery_product(&b_tmp, num_b, &num_montgomery_factor, num_n);
-	number_montgomery_product(num_res, &a_tmp, &b_tmp, num_n);
-	number_montgomery_product(num_res, &NUM_1, num_res, num_n);
-	ret = 0;
+	number_mod(&q_mod_p, q, p);
+	if (number_is_equal(&q_mod_p, &NUM_0))
+		return -1;
 
-	TIMER_STOP(FUNC_NUMBER_MODULAR_MULTIPLICATION_MONTGOMERY);
+	number_assign(crt->p, *p);
+	number_assign(crt->q, *q);
+	number_sub(&p_min1, p, &NUM_1);
+	number_sub(&q_min1, q, &NUM_1);
+	number_mod(&crt->dp, d, &p_min1);
+	number_mod(&crt->dq, d, &q_min1);
+	number_modular_multiplicative_inverse(&crt->qinv, &q_mod_p, p);
+
+	number_enclevl_halve();
+	number_montgomery_ctx_init(&ctx, &crt->p, NULL);
+	number_montgomery_ctx_factor_get(&ctx, &crt->factor_p);
+	number_montgomery_ctx_init(&ctx, &crt->q, NULL);
+	number_montgomery_ctx_factor_get(&ctx, &crt->factor_q);
+	number_enclevl_double();
+
+	return 0;
+}
+
+/* a^d mod pq, 0 <= a < pq:
+ *   m1 = a^dp mod p
+ *   m2 = a^dq mod q
+ *   h = qinv*(m1 - m2) mod p (garner)
+ *   return m2 + h*q
+ * both exponentiations and the recombination are done at half the encryption
+ * level */
+int number_modular_exponentiation_crt(u1024_t *res, u1024_t *a,
+	crt_key_t *crt)
+{
+	int ret;
+
+	TIMER_START(FUNC_NUMBER_MODULAR_EXPONENTIATION_CRT);
+	ret = number_modular_exponentiation_crt_batch(&res, &a, 1, crt);
+	TIMER_STOP(FUNC_NUMBER_MODULAR_EXPONENTIATION_CRT);
 	return ret;
 }
 
-/* montgomery (right-left, speed optimised) modular exponentiation procedure:
- * MonExp(a, b, n)
- *   c = 2^(2n)
- *   A = MonPro(c, a, n) (mapping)
- *   r = MonPro(c, 1, n)
- *   for i = 0 to k-1 do
- *     if (bi==1) then
- *       r = MonPro(r, a, n) (multiply)
- *     end if
- *     A = MonPro(A, A, n) (square)
- *   end for
- *   r = MonPro(1, r, n)
- *   return r
- */
-int INLINE number_modular_exponentiation_montgomery(u1024_t *res, u1024_t *a,
-	u1024_t *b, u1024_t *n)
+/* res[i] = a[i]^d mod pq, i < num, as number_modular_exponentiation_crt().
+ * the exponentiations of up to NUMBER_LANES numbers modulo p, and then
+ * modulo q, are batched. res[i] may be a[i] */
+int number_modular_exponentiation_crt_batch(u1024_t **res, u1024_t **a,
+	int num, crt_key_t *crt)
 {
-	u1024_t a_nresidue;
-	u64 *seg;
-	int ret = 0;
+	u1024_t a_hi[NUMBER_LANES], a_lo[NUMBER_LANES], a_mod[NUMBER_LANES];
+	u1024_t m1[NUMBER_LANES], m2[NUMBER_LANES], h[NUMBER_LANES];
+	u1024_t *a_mod_ptr[NUMBER_LANES], *m1_ptr[NUMBER_LANES];
+	u1024_t *m2_ptr[NUMBER_LANES], m2_mod_p, tmp;
+	montgomery_ctx_t mont_p, mont_q;
+	int i, j, lanes, half = block_sz_u1024 >> 1;
+
+	for (i = 0; i < num; i += lanes) {
+		lanes = num - i < NUMBER_LANES ? num - i : NUMBER_LANES;
+
+		/* upper limbs must be clear once back at the full encryption
+		 * level */
+		for (j = 0; j < lanes; j++) {
+			int l;
+
+			number_reset(&a_hi[j]);
+			number_reset(&a_lo[j]);
+			number_reset(&a_mod[j]);
+			number_reset(&m1[j]);
+			number_reset(&m2[j]);
+			number_reset(&h[j]);
+			for (l = 0; l < half; l++) {
+				a_lo[j].arr[l] = a[i + j]->arr[l];
+				a_hi[j].arr[l] = a[i + j]->arr[half + l];
+			}
+			a_mod_ptr[j] = &a_mod[j];
+			m1_ptr[j] = &m1[j];
+			m2_ptr[j] = &m2[j];
+		}
+		number_reset(&m2_mod_p);
+		number_reset(&tmp);
 
-	TIMER_START(FUNC_NUMBER_MODULAR_EXPONENTIATION_MONTGOMERY);
-	number_montgomery_factor_set(n, NULL);
-	number_montgomery_product(&a_nresidue, &num_montgomery_factor, a, n);
-	number_assign(*res, num_res_nresidue);
+		number_enclevl_halve();
+		for (j = 0; j < lanes; j++) {
+			number_top_set(&a_lo[j]);
+			number_top_set(&a_hi[j]);
+		}
 
-	for (seg = (u64*)&b->arr; seg < (u64*)&b->arr + block_sz_u1024; seg++) {
-		u64 mask;
+		number_montgomery_ctx_init(&mont_q, &crt->q, &crt->factor_q);
+		number_montgomery_ctx_init(&mont_p, &crt->p, &crt->factor_p);
 
-		for (mask = (u64)1; mask; mask = mask << 1) {
-			if (*seg & mask) {
-				number_montgomery_product(res, res, &a_nresidue,
- 					n);
-			}
-			number_montgomery_product(&a_nresidue, &a_nresidue,
-				&a_nresidue, n);
+		/* m2 = a^dq mod q */
+		for (j = 0; j < lanes; j++) {
+			number_crt_reduce(&a_mod[j], &a_hi[j], &a_lo[j],
+				&mont_q);
+		}
+		number_montgomery_exponentiation_batch(m2_ptr, a_mod_ptr, lanes,
+			&crt->dq, &mont_q);
+
+		/* m1 = a^dp mod p */
+		for (j = 0; j < lanes; j++) {
+			number_crt_reduce(&a_mod[j], &a_hi[j], &a_lo[j],
+				&mont_p);
+		}
+		number_montgomery_exponentiation_batch(m1_ptr, a_mod_ptr, lanes,
+			&crt->dp, &mont_p);
+
+		/* h = qinv*(m1 - m2) mod p, m2 < q is not necessarily smaller
+		 * than p */
+		for (j = 0; j < lanes; j++) {
+			number_montgomery_product(&m2_mod_p, &m2[j], &mont_p.rr,
+				&mont_p);
+			number_montgomery_product(&m2_mod_p, &NUM_1, &m2_mod_p,
+				&mont_p);
+			if (number_is_greater(&m2_mod_p, &m1[j]))
+				number_add(&m1[j], &m1[j], &crt->p);
+			number_sub(&m1[j], &m1[j], &m2_mod_p);
+			number_montgomery_product(&tmp, &crt->qinv, &mont_p.rr,
+				&mont_p);
+			number_montgomery_product(&h[j], &tmp, &m1[j], &mont_p);
+		}
+		number_enclevl_double();
+
+		/* res = m2 + h*q */
+		for (j = 0; j < lanes; j++) {
+			number_mul(&tmp, &h[j], &crt->q);
+			number_add(res[i + j], &tmp, &m2[j]);
 		}
 	}
-	number_montgomery_product(res, &NUM_1, res, n);
 
-	TIMER_STOP(FUNC_NUMBER_MODULAR_EXPONENTIATION_MONTGOMERY);
-	return ret;
+	return 0;
 }
 
 static void INLINE number_witness_init(u1024_t *num_n_min1, u1024_t *num_u,
 	int *t)
 {
-	u1024_t tmp;
-
 	TIMER_START(FUNC_NUMBER_WITNESS_INIT);
-	number_assign(tmp, *num_n_min1);
+	number_assign(*num_u, *num_n_min1);
 	*t = 0;
-	while (!number_is_odd(&tmp)) {
-		number_shift_right_once(&tmp);
+	while (!number_is_odd(num_u)) {
+		number_shift_right_once(num_u);
 		(*t)++;
 	}
-
-	number_assign(*num_u, tmp);
 	TIMER_STOP(FUNC_NUMBER_WITNESS_INIT);
 }
 
@@ -613,9 +2045,10 @@ static void INLINE number_witness_init(u1024_t *num_n_min1, u1024_t *num_u,
  * witness of num_n's compositeness:
  * if number_witness(num_a, num_n) is true, then num_n is composite
  */
-STATIC int INLINE number_witness(u1024_t *num_a, u1024_t *num_n)
+static int INLINE number_witness_ctx(u1024_t *num_a, montgomery_ctx_t *ctx)
 {
-	u1024_t num_u, num_x_prev, num_x_curr, num_n_min1;
+	u1024_t num_u, num_x[2], num_n_min1, *x_prev, *x_curr;
+	u1024_t num_1_nresidue, num_n_min1_nresidue, *num_n = &ctx->n;
 	int i, t, ret;
 
 	TIMER_START(FUNC_NUMBER_WITNESS);
@@ -626,28 +2059,36 @@ STATIC int INLINE number_witness(u1024_t *num_a, u1024_t *num_n)
 
 	number_sub(&num_n_min1, num_n, &NUM_1);
 	number_witness_init(&num_n_min1, &num_u, &t);
-	if (number_modular_exponentiation_montgomery(&num_x_prev, num_a, &num_u,
-		num_n)) {
+	x_prev = &num_x[0];
+	x_curr = &num_x[1];
+	if (number_montgomery_exponentiation(x_prev, num_a, &num_u, ctx)) {
 		ret = 1;
 		goto Exit;
 	}
 
+	/* the t squarings are done in the n-residue domain, where 1 and n-1
+	 * are represented by r%n and n-r%n respectively. x_prev and x_curr
+	 * swap roles rather than values */
+	number_montgomery_product(x_prev, x_prev, &ctx->rr, ctx);
+	number_assign(num_1_nresidue, ctx->r);
+	number_sub(&num_n_min1_nresidue, num_n, &num_1_nresidue);
+
 	for (i = 0; i < t; i++) {
-		if (number_modular_multiplication_montgomery(&num_x_curr,
-			&num_x_prev, &num_x_prev, num_n)) {
-			ret = 1;
-			goto Exit;
-		}
-		if (number_is_equal(&num_x_curr, &NUM_1) &&
-			!number_is_equal(&num_x_prev, &NUM_1) &&
-			!number_is_equal(&num_x_prev, &num_n_min1)){
+		u1024_t *tmp;
+
+		number_montgomery_product(x_curr, x_prev, x_prev, ctx);
+		if (number_is_equal(x_curr, &num_1_nresidue) &&
+			!number_is_equal(x_prev, &num_1_nresidue) &&
+			!number_is_equal(x_prev, &num_n_min1_nresidue)) {
 			ret = 1;
 			goto Exit;
 		}
-		number_assign(num_x_prev, num_x_curr);
+		tmp = x_prev;
+		x_prev = x_curr;
+		x_curr = tmp;
 	}
 
-	if (!number_is_equal(&num_x_curr, &NUM_1)) {
+	if (!number_is_equal(x_prev, &num_1_nresidue)) {
 		ret = 1;
 		goto Exit;
 	}
@@ -658,6 +2099,17 @@ Exit:
 	return ret;
 }
 
+STATIC int INLINE number_witness(u1024_t *num_a, u1024_t *num_n)
+{
+	montgomery_ctx_t ctx;
+
+	if (!number_is_odd(num_n))
+		return 1;
+
+	number_montgomery_ctx_init(&ctx, num_n, NULL);
+	return number_witness_ctx(num_a, &ctx);
+}
+
 /* miller-rabin algorithm
  * num_n is an odd integer greater than 2
  * return:
@@ -668,13 +2120,16 @@ STATIC int INLINE number_miller_rabin(u1024_t *num_n, u1024_t *num_s)
 {
 	int ret;
 	u1024_t num_j, num_a;
+	montgomery_ctx_t ctx;
 
 	TIMER_START(FUNC_NUMBER_MILLER_RABIN);
 	number_assign(num_j, NUM_1);
+	/* a single montgomery context serves all witnesses */
+	number_montgomery_ctx_init(&ctx, num_n, NULL);
 
 	while (!number_is_equal(&num_j, num_s)) {
 		number_init_random_strict_range(&num_a, num_n);
-		if (number_witness(&num_a, num_n)) {
+		if (number_witness_ctx(&num_a, &ctx)) {
 			ret = 0;
 			goto Exit;
 		}
@@ -739,8 +2194,9 @@ STATIC void INLINE number_generate_coprime(u1024_t *num_coprime,
 	u1024_t *num_increment)
 {
 	int i;
-	static u1024_t num_pi, num_mod, num_jumper, num_inc;
-	static small_prime_entry_t
+	static __thread u1024_t num_pi, num_mod, num_jumper, num_inc;
+	static __thread barrett_ctx_t barrett_pi;
+	static __thread small_prime_entry_t
 		small_primes[NUMBER_GENERATE_COPRIME_ARRAY_SZ] = {
 		{2}, {3}, {5}, {7}, {11}, {13}, {17}, {19}, {23}, {29}, {31},
 		{37}, {41}
@@ -780,6 +2236,7 @@ STATIC void INLINE number_generate_coprime(u1024_t *num_coprime,
 			number_small_prime_init(&small_primes[i],
 				exp_initializer[i], &num_pi, &num_inc);
 		}
+		number_barrett_ctx_init(&barrett_pi, &num_pi);
 
 		number_generate_coprime_init = 1;
 	}
@@ -793,15 +2250,15 @@ STATIC void INLINE number_generate_coprime(u1024_t *num_coprime,
 
 		do {
 			number_init_random(&num_a, block_sz_u1024/2);
-			number_modular_exponentiation_naive(&num_a_pow, &num_a,
-				&(small_primes[i].exp), &num_pi);
+			number_modular_exponentiation_barrett(&num_a_pow,
+				&num_a, &(small_primes[i].exp), &barrett_pi);
 		}
 		while (number_is_equal(&num_a_pow, &NUM_0));
 		number_add(num_coprime, num_coprime, &num_a);
 	}
 
 	/* bound num_coprime to be less than num_pi */
-	number_mod(num_coprime, num_coprime, &num_pi);
+	number_barrett_mod(num_coprime, num_coprime, &barrett_pi);
 
 	/* refine num_coprime:
 	 * if num_coprime % small_primes[i].prime == 0, then
@@ -823,65 +2280,133 @@ STATIC void INLINE number_generate_coprime(u1024_t *num_coprime,
 	TIMER_STOP(FUNC_NUMBER_GENERATE_COPRIME);
 }
 
+/* n0, n1, n2 = n1, n2, n0 */
+#define NUMBER_ROTATE(n0, n1, n2) do { \
+	u1024_t *__tmp = (n0); \
+	(n0) = (n1); \
+	(n1) = (n2); \
+	(n2) = __tmp; \
+} while (0)
+
 /* determine x, y and gcd according to a and b such that:
  * ax+by == gcd(a, b)
  * NOTE: a is assumed to be >= b */
 STATIC void INLINE number_extended_euclid_gcd(u1024_t *gcd, u1024_t *x,
 	u1024_t *a, u1024_t *y, u1024_t *b)
 {
-	u1024_t num_x, num_x1, num_x2, num_y, num_y1, num_y2;
-	u1024_t num_a, num_b, num_q, num_r;
+	/* the remainders and coefficients of three consecutive steps rotate
+	 * through [0, 3) rather than being copied down on each step:
+	 * r[i+2] = r[i] - q*r[i+1], likewise x and y */
+	u1024_t num_r[3], num_x[3], num_y[3], num_q;
+	u1024_t *r0 = &num_r[0], *r1 = &num_r[1], *r2 = &num_r[2];
+	u1024_t *x0 = &num_x[0], *x1 = &num_x[1], *x2 = &num_x[2];
+	u1024_t *y0 = &num_y[0], *y1 = &num_y[1], *y2 = &num_y[2];
 	int change;
 
 	TIMER_START(FUNC_NUMBER_EXTENDED_EUCLID_GCD);
 	if (number_is_greater_or_equal(a, b)) {
-		number_assign(num_a, *a);
-		number_assign(num_b, *b);
+		number_assign(*r0, *a);
+		number_assign(*r1, *b);
 		change = 0;
 	}
 	else {
-		number_assign(num_a, *b);
-		number_assign(num_b, *a);
+		number_assign(*r0, *b);
+		number_assign(*r1, *a);
 		change = 1;
 	}
 
-	number_assign(num_x1, NUM_0);
-	number_assign(num_x2, NUM_1);
-	number_assign(num_y1, NUM_1);
-	number_assign(num_y2, NUM_0);
+	number_assign(*x0, NUM_1);
+	number_assign(*x1, NUM_0);
+	number_assign(*y0, NUM_0);
+	number_assign(*y1, NUM_1);
 
-	while (number_is_greater(&num_b, &NUM_0)) {
-		number_dev(&num_q, &num_r, &num_a, &num_b);
+	while (number_is_greater(r1, &NUM_0)) {
+		number_dev(&num_q, r2, r0, r1);
 
-		number_mul(&num_x, &num_x1, &num_q);
-		number_sub(&num_x, &num_x2, &num_x);
-		number_mul(&num_y, &num_y1, &num_q);
-		number_sub(&num_y, &num_y2, &num_y);
+		number_mul(x2, x1, &num_q);
+		number_sub(x2, x0, x2);
+		number_mul(y2, y1, &num_q);
+		number_sub(y2, y0, y2);
 
-		number_assign(num_a, num_b);
-		number_assign(num_b, num_r);
-		number_assign(num_x2, num_x1);
-		number_assign(num_x1, num_x);
-		number_assign(num_y2, num_y1);
-		number_assign(num_y1, num_y);
+		NUMBER_ROTATE(r0, r1, r2);
+		NUMBER_ROTATE(x0, x1, x2);
+		NUMBER_ROTATE(y0, y1, y2);
 	}
 
-	number_assign(*x, change ? num_y2 : num_x2);
-	number_assign(*y, change ? num_x2 : num_y2);
-	number_assign(*gcd, change ? num_b : num_a);
+	number_assign(*x, change ? *y0 : *x0);
+	number_assign(*y, change ? *x0 : *y0);
+	number_assign(*gcd, *r0);
 	TIMER_STOP(FUNC_NUMBER_EXTENDED_EUCLID_GCD);
 }
 
-STATIC void INLINE number_euclid_gcd(u1024_t *gcd, u1024_t *a, u1024_t *b)
+/* num = num / 2^z, where 2^z is the largest power of 2 dividing num != 0.
+ * returns z */
+static int INLINE number_make_odd(u1024_t *num)
 {
-	u1024_t x, y;
+	u64 *seg = (u64*)&num->arr;
+	int i, limbs, bits, z;
+
+	for (limbs = 0; !seg[limbs]; limbs++);
+	for (bits = 0; !((seg[limbs] >> bits) & (u64)1); bits++);
+	z = limbs * bit_sz_u64 + bits;
+
+	for (i = 0; i + limbs < block_sz_u1024; i++) {
+		seg[i] = seg[i + limbs] >> bits;
+		if (bits && i + limbs + 1 < block_sz_u1024) {
+			seg[i] |= (u64)(seg[i + limbs + 1] <<
+				(bit_sz_u64 - bits));
+		}
+	}
+	for ( ; i < block_sz_u1024; i++)
+		seg[i] = 0;
+	number_top_set(num);
 
-	TIMER_START(FUNC_NUMBER_EUCLID_GCD);
-	if (number_is_greater_or_equal(a, b))
-		number_extended_euclid_gcd(gcd, &x, a, &y, b);
-	else
-		number_extended_euclid_gcd(gcd, &y, b, &x, a);
-	TIMER_STOP(FUNC_NUMBER_EUCLID_GCD);
+	return z;
+}
+
+/* binary gcd - stein's algorithm. a and b are subtracted and halved rather
+ * than divided:
+ *   z = the number of factors of 2 common to a and b
+ *   a = a / 2^k, where a / 2^k is odd
+ *   repeat
+ *     b = b / 2^k, where b / 2^k is odd
+ *     if a > b, swap a and b
+ *     b = b - a (even)
+ *   until b == 0
+ *   gcd = a * 2^z */
+STATIC void INLINE number_binary_gcd(u1024_t *gcd, u1024_t *a, u1024_t *b)
+{
+	u1024_t num_u, num_v, *u = &num_u, *v = &num_v, *tmp;
+	int z, z_v;
+
+	TIMER_START(FUNC_NUMBER_BINARY_GCD);
+	if (number_is_equal(a, &NUM_0) || number_is_equal(b, &NUM_0)) {
+		number_assign(*gcd, number_is_equal(a, &NUM_0) ? *b : *a);
+		goto Exit;
+	}
+
+	number_assign(num_u, *a);
+	number_assign(num_v, *b);
+	z = number_make_odd(u);
+	if ((z_v = number_make_odd(v)) < z)
+		z = z_v;
+	do {
+		number_make_odd(v);
+		if (number_is_greater(u, v)) {
+			tmp = u;
+			u = v;
+			v = tmp;
+		}
+		number_sub(v, v, u);
+	}
+	while (!number_is_equal(v, &NUM_0));
+
+	number_assign(*gcd, *u);
+	while (z--)
+		number_shift_left_once(gcd);
+
+Exit:
+	TIMER_STOP(FUNC_NUMBER_BINARY_GCD);
 }
 
 void number_init_random_coprime(u1024_t *num, u1024_t *coprime)
@@ -891,47 +2416,287 @@ void number_init_random_coprime(u1024_t *num, u1024_t *coprime)
 	TIMER_START(FUNC_NUMBER_INIT_RANDOM_COPRIME);
 	do {
 		number_init_random_strict_range(num, coprime);
-		number_euclid_gcd(&num_gcd, num, coprime);
+		number_binary_gcd(&num_gcd, num, coprime);
 	}
 	while (!number_is_equal(&num_gcd, &NUM_1));
 	TIMER_STOP(FUNC_NUMBER_INIT_RANDOM_COPRIME);
 }
 
-/* assumption: 0 < num < mod */
+/* the NUMBER_LEHMER_BITS bits of num from bit shift up */
+static u64 INLINE number_lehmer_bits(u1024_t *num, int shift)
+{
+	u64 *seg = (u64*)&num->arr + shift / bit_sz_u64;
+	int bits = shift % bit_sz_u64;
+	u64 ret = seg[0] >> bits;
+
+	if (bits && shift / bit_sz_u64 + 1 < block_sz_u1024)
+		ret |= (u64)(seg[1] << (bit_sz_u64 - bits));
+	return ret & (u64)(((u64)1 << NUMBER_LEHMER_BITS) - 1);
+}
+
+/* res = a*x + b*y, or a*x - b*y if is_sub. 0 <= res < w^block_sz_u1024.
+ * res may be x or y */
+static void INLINE number_lehmer_combine(u1024_t *res, u64 a, u1024_t *x,
+	u64 b, u1024_t *y, int is_sub)
+{
+	u64 ax[RSA_NUMBER_ARRAY_SZ + 1], by[RSA_NUMBER_ARRAY_SZ + 1];
+	u64 carry_a = 0, carry_b = 0;
+	int i, k = block_sz_u1024;
+
+	for (i = 0; i < k; i++) {
+		u128 acc_a = (u128)a * *((u64*)&x->arr + i) + carry_a;
+		u128 acc_b = (u128)b * *((u64*)&y->arr + i) + carry_b;
+
+		ax[i] = (u64)acc_a;
+		by[i] = (u64)acc_b;
+		carry_a = (u64)(acc_a >> bit_sz_u64);
+		carry_b = (u64)(acc_b >> bit_sz_u64);
+	}
+	ax[k] = carry_a;
+	by[k] = carry_b;
+
+	if (is_sub)
+		number_limbs_sub(ax, k + 1, by, k + 1);
+	else
+		number_limbs_add(ax, k + 1, by, k + 1);
+	for (i = 0; i <= k; i++)
+		*((u64*)&res->arr + i) = i < k ? ax[i] : 0;
+	number_top_set(res);
+}
+
+/* lehmer's gcd - knuth, the art of computer programming, vol. 2, 4.5.2,
+ * algorithm L. the euclid algorithm is run on the leading bits of u and v,
+ * with a single precision quotient per step, for as long as the quotient is
+ * that of u and v. the steps are then applied to u and v at once:
+ *   u^, v^ = the leading bits of u and the bits of v at the same positions
+ *   A, B, C, D = 1, 0, 0, 1
+ *   while q = (u^ + A) / (v^ + C) == (u^ + B) / (v^ + D)
+ *     A, B, C, D = C, D, A - q*C, B - q*D
+ *     u^, v^ = v^, u^ - q*v^
+ *   if B == 0 (no steps), u, v = v, u mod v
+ *   else u, v = A*u + B*v, C*u + D*v
+ * the signs of A, B, C, D alternate with each step, so magnitudes are kept.
+ * only num's cofactor, y, is followed: mod*x + num*y = u. its sign alternates
+ * as well, so its magnitude is kept and |y| <= mod.
+ * returns -1 if num and mod are not coprime */
+static int INLINE number_lehmer_inverse(u1024_t *inv, u1024_t *num,
+	u1024_t *mod)
+{
+	u1024_t num_u, num_v, num_y0, num_y1, num_q, num_r;
+	u1024_t *u = &num_u, *v = &num_v, *y0 = &num_y0, *y1 = &num_y1, *tmp;
+	int shift, odd, is_y0_negative = 1;
+
+	number_assign(num_u, *mod);
+	number_assign(num_v, *num);
+	number_assign(num_y0, NUM_0);
+	number_assign(num_y1, NUM_1);
+
+	while (!number_is_equal(v, &NUM_0)) {
+		u64 u_hat, v_hat, a = 1, b = 0, c = 0, d = 1;
+
+		if ((shift = number_bit_length(u) - NUMBER_LEHMER_BITS) < 0)
+			shift = 0;
+		u_hat = number_lehmer_bits(u, shift);
+		v_hat = number_lehmer_bits(v, shift);
+		for (odd = 0; ; odd = !odd) {
+			u64 num_a, num_b, den_c, den_d, q, t;
+
+			/* u^ + A, u^ + B, v^ + C, v^ + D */
+			if (odd ? u_hat < a || v_hat <= d :
+				u_hat < b || v_hat <= c) {
+				break;
+			}
+			num_a = odd ? u_hat - a : u_hat + a;
+			num_b = odd ? u_hat + b : u_hat - b;
+			den_c = odd ? v_hat + c : v_hat - c;
+			den_d = odd ? v_hat - d : v_hat + d;
+			if ((q = num_a / den_c) != num_b / den_d)
+				break;
+
+			t = a + q * c;
+			a = c;
+			c = t;
+			t = b + q * d;
+			b = d;
+			d = t;
+			t = u_hat - q * v_hat;
+			u_hat = v_hat;
+			v_hat = t;
+		}
+
+		if (!b) {
+			number_dev(&num_q, &num_r, u, v);
+			number_assign(*u, *v);
+			number_assign(*v, num_r);
+			number_mul(&num_q, &num_q, y1);
+			number_add(y0, y0, &num_q);
+			tmp = y0;
+			y0 = y1;
+			y1 = tmp;
+			odd = 1;
+		}
+		else {
+			number_lehmer_combine(&num_r, odd ? b : a, odd ? v : u,
+				odd ? a : b, odd ? u : v, 1);
+			number_lehmer_combine(v, odd ? c : d, odd ? u : v,
+				odd ? d : c, odd ? v : u, 1);
+			number_assign(*u, num_r);
+			number_lehmer_combine(&num_r, a, y0, b, y1, 0);
+			number_lehmer_combine(y1, c, y0, d, y1, 0);
+			number_assign(*y0, num_r);
+		}
+		if (odd)
+			is_y0_negative = !is_y0_negative;
+	}
+
+	if (!number_is_equal(u, &NUM_1))
+		return -1;
+
+	if (is_y0_negative)
+		number_sub(inv, mod, y0);
+	else
+		number_assign(*inv, *y0);
+	return 0;
+}
+
+/* assumption: 0 < num < mod. returns -1 if num has no inverse modulo mod */
 int number_modular_multiplicative_inverse(u1024_t *inv, u1024_t *num,
 	u1024_t *mod)
 {
-	u1024_t num_x, num_y, num_gcd, num_y_abs;
+	int ret;
 
 	TIMER_START(FUNC_NUMBER_MODULAR_MULTIPLICATIVE_INVERSE);
-	number_extended_euclid_gcd(&num_gcd, &num_x, mod, &num_y, num);
-	number_absolute_value(&num_y_abs, &num_y);
-	number_mod(inv, &num_y_abs, mod);
-
-	if (!number_is_equal(&num_y_abs, &num_y))
-		number_sub(inv, mod, inv);
+	ret = number_lehmer_inverse(inv, num, mod);
 	TIMER_STOP(FUNC_NUMBER_MODULAR_MULTIPLICATIVE_INVERSE);
-	return !number_gcd_is_1(num, inv);
+	return ret;
 }
 
-void number_find_prime(u1024_t *num)
+/* num mod p, for small p (p^2 < 2^32). r is accumulated from the most
+ * significant u64 down using w mod p, w = 2^bit_sz_u64 */
+static unsigned int INLINE number_small_mod(u1024_t *num, unsigned int p)
+{
+	unsigned long long w, r = 0;
+	int i;
+
+	w = ((unsigned long long)1 << (bit_sz_u64 >> 1)) % p;
+	w = w * w % p;
+	for (i = num->top; i >= 0; i--)
+		r = (r * w + *((u64*)&num->arr + i) % p) % p;
+
+	return (unsigned int)r;
+}
+
+/* the small odd primes following the first NUMBER_GENERATE_COPRIME_ARRAY_SZ
+ * primes, which do not divide any candidate to begin with */
+static void INLINE number_sieve_primes_init(void)
+{
+	unsigned int n, d;
+	int i;
+
+	if (*number_sieve_primes)
+		return;
+
+	for (i = 0, n = 43; i < NUMBER_SIEVE_PRIMES; n += 2) {
+		for (d = 3; d * d <= n && n % d; d += 2);
+		if (d * d > n)
+			number_sieve_primes[i++] = n;
+	}
+}
+
+/* residues of the candidate and of the increment modulo the sieve primes */
+static void INLINE number_sieve_init(unsigned int *residues,
+	unsigned int *steps, u1024_t *num_candidate, u1024_t *num_increment)
+{
+	int i;
+
+	TIMER_START(FUNC_NUMBER_SIEVE_INIT);
+	number_sieve_primes_init();
+	for (i = 0; i < NUMBER_SIEVE_PRIMES; i++) {
+		residues[i] = number_small_mod(num_candidate,
+			number_sieve_primes[i]);
+		steps[i] = number_small_mod(num_increment,
+			number_sieve_primes[i]);
+	}
+	TIMER_STOP(FUNC_NUMBER_SIEVE_INIT);
+}
+
+/* returns 1 if the candidate has a small factor. the residues are advanced to
+ * the next candidate in any case */
+static int INLINE number_sieve_step(unsigned int *residues,
+	unsigned int *steps)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < NUMBER_SIEVE_PRIMES; i++) {
+		if (!residues[i])
+			ret = 1;
+		residues[i] += steps[i];
+		if (residues[i] >= number_sieve_primes[i])
+			residues[i] -= number_sieve_primes[i];
+	}
+
+	return ret;
+}
+
+void number_sieve_stats_get(unsigned long *hits, unsigned long *misses)
+{
+	*hits = number_sieve_hits;
+	*misses = number_sieve_misses;
+}
+
+/* candidates are stepped by the product of the first
+ * NUMBER_GENERATE_COPRIME_ARRAY_SZ primes. an incremental sieve over the
+ * following NUMBER_SIEVE_PRIMES primes rejects most composite candidates
+ * before they reach miller-rabin:
+ *   hits - candidates rejected by the sieve
+ *   misses - candidates handed to number_is_prime()
+ * threads racing on a prime poll cancel, if given, between candidates. once
+ * it is set the search is abandoned and -1 is returned */
+int number_find_prime_race(u1024_t *num, int *cancel)
 {
 	u1024_t num_candidate, num_increment;
+	unsigned int residues[NUMBER_SIEVE_PRIMES], steps[NUMBER_SIEVE_PRIMES];
+	int ret = 0;
 
 	TIMER_START(FUNC_NUMBER_FIND_PRIME);
 	number_generate_coprime(&num_candidate, &num_increment);
+	number_sieve_init(residues, steps, &num_candidate, &num_increment);
+
+	while (1) {
+		if (cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED)) {
+			ret = -1;
+			goto Exit;
+		}
 
-	while (!(number_is_prime(&num_candidate))) {
+		if (number_sieve_step(residues, steps)) {
+			number_sieve_hits++;
+		}
+		else {
+			number_sieve_misses++;
+			if (number_is_prime(&num_candidate))
+				break;
+		}
 		number_add(&num_candidate, &num_candidate, &num_increment);
 
 		/* highly unlikely event of rollover rendering
 		 * num_candidate == 1 */
-		if (number_is_equal(&num_candidate, &NUM_1))
+		if (number_is_equal(&num_candidate, &NUM_1)) {
 			number_generate_coprime(&num_candidate, &num_increment);
+			number_sieve_init(residues, steps, &num_candidate,
+				&num_increment);
+		}
 	}
 
 	number_assign(*num, num_candidate);
+
+Exit:
 	TIMER_STOP(FUNC_NUMBER_FIND_PRIME);
+	return ret;
+}
+
+void number_find_prime(u1024_t *num)
+{
+	number_find_prime_race(num, NULL);
 }
 
 int number_str2num(u1024_t *num, char *str)
@@ -947,6 +2712,173 @@ int number_str2num(u1024_t *num, char *str)
 	return 0;
 }
 
+/* number layer contexts.
+ * the number_*() functions, and the macros in rsa_num.h, work at the calling
+ * thread's encryption level and draw from the thread's prng. a number_ctx_*()
+ * function installs its context as the thread's for the duration of the call
+ * and restores the thread's own level and prng on return */
+typedef struct {
+	int encryption_level;
+	prng_t *prng;
+} number_ctx_save_t;
+
+/* unlike number_enclevl_set(), the tables generated by
+ * number_generate_coprime() are kept as long as the level does not change */
+static void number_enclevl_switch(int level)
+{
+	if (level == encryption_level)
+		return;
+
+	encryption_level = level;
+	block_sz_u1024 = encryption_level / bit_sz_u64;
+	number_kernels_select();
+	number_generate_coprime_init = 0;
+}
+
+static void number_ctx_enter(number_ctx_t *ctx, number_ctx_save_t *save)
+{
+	save->encryption_level = encryption_level;
+	save->prng = number_prng;
+	number_enclevl_switch(ctx->encryption_level);
+	number_prng = &ctx->prng;
+}
+
+static void number_ctx_leave(number_ctx_save_t *save)
+{
+	number_enclevl_switch(save->encryption_level);
+	number_prng = save->prng;
+}
+
+#define NUMBER_CTX_CALL(ctx, call) do { \
+	number_ctx_save_t __save; \
+	number_ctx_enter(ctx, &__save); \
+	call; \
+	number_ctx_leave(&__save); \
+} while (0)
+
+int number_ctx_init(number_ctx_t *ctx, int level)
+{
+	int *ptr;
+
+	for (ptr = encryption_levels; *ptr && *ptr != level; ptr++);
+	if (!*ptr || level / bit_sz_u64 >= RSA_NUMBER_ARRAY_SZ)
+		return -1;
+
+	memset(ctx, 0, sizeof(number_ctx_t));
+	ctx->encryption_level = level;
+#ifdef MERSENNE_TWISTER
+	ctx->prng.mt = (mt19937_64_t)MT19937_64_INITIALIZER;
+#endif
+	return 0;
+}
+
+/* seed == 0 seeds the context's prng from the time of day */
+int number_ctx_seed_set(number_ctx_t *ctx, prng_seed_t seed)
+{
+	prng_seed_t ret;
+
+	NUMBER_CTX_CALL(ctx, ret = number_seed_set(seed));
+	return ret ? 0 : -1;
+}
+
+void number_ctx_add(number_ctx_t *ctx, u1024_t *res, u1024_t *num1,
+	u1024_t *num2)
+{
+	NUMBER_CTX_CALL(ctx, number_add(res, num1, num2));
+}
+
+void number_ctx_sub(number_ctx_t *ctx, u1024_t *res, u1024_t *num1,
+	u1024_t *num2)
+{
+	NUMBER_CTX_CALL(ctx, number_sub(res, num1, num2));
+}
+
+void number_ctx_mul(number_ctx_t *ctx, u1024_t *res, u1024_t *num1,
+	u1024_t *num2)
+{
+	NUMBER_CTX_CALL(ctx, number_mul(res, num1, num2));
+}
+
+void number_ctx_dev(number_ctx_t *ctx, u1024_t *num_q, u1024_t *num_r,
+	u1024_t *num_dividend, u1024_t *num_divisor)
+{
+	NUMBER_CTX_CALL(ctx, number_dev(num_q, num_r, num_dividend,
+		num_divisor));
+}
+
+u64 number_ctx_random(number_ctx_t *ctx)
+{
+	u64 ret;
+
+	NUMBER_CTX_CALL(ctx, ret = number_random());
+	return ret;
+}
+
+int number_ctx_init_random(number_ctx_t *ctx, u1024_t *num, int blocks)
+{
+	int ret;
+
+	NUMBER_CTX_CALL(ctx, ret = number_init_random(num, blocks));
+	return ret;
+}
+
+int number_ctx_find_prime(number_ctx_t *ctx, u1024_t *num, int *cancel)
+{
+	int ret;
+
+	NUMBER_CTX_CALL(ctx, ret = number_find_prime_race(num, cancel));
+	return ret;
+}
+
+int number_ctx_modular_multiplicative_inverse(number_ctx_t *ctx,
+	u1024_t *inv, u1024_t *num, u1024_t *mod)
+{
+	int ret;
+
+	NUMBER_CTX_CALL(ctx,
+		ret = number_modular_multiplicative_inverse(inv, num, mod));
+	return ret;
+}
+
+/* set up the context's montgomery context for the odd modulus num_n, see
+ * number_montgomery_ctx_init() */
+void number_ctx_montgomery_set(number_ctx_t *ctx, u1024_t *num_n,
+	u1024_t *num_factor)
+{
+	NUMBER_CTX_CALL(ctx,
+		number_montgomery_ctx_init(&ctx->mont, num_n, num_factor));
+}
+
+/* res = a^b mod n, n being the modulus set by number_ctx_montgomery_set() */
+int number_ctx_modular_exponentiation(number_ctx_t *ctx, u1024_t *res,
+	u1024_t *a, u1024_t *b)
+{
+	int ret;
+
+	NUMBER_CTX_CALL(ctx,
+		ret = number_montgomery_exponentiation(res, a, b, &ctx->mont));
+	return ret;
+}
+
+int number_ctx_crt_key_init(number_ctx_t *ctx, crt_key_t *crt, u1024_t *p,
+	u1024_t *q, u1024_t *d)
+{
+	int ret;
+
+	NUMBER_CTX_CALL(ctx, ret = number_crt_key_init(crt, p, q, d));
+	return ret;
+}
+
+int number_ctx_modular_exponentiation_crt(number_ctx_t *ctx, u1024_t *res,
+	u1024_t *a, crt_key_t *crt)
+{
+	int ret;
+
+	NUMBER_CTX_CALL(ctx, ret = number_modular_exponentiation_crt(res, a,
+		crt));
+	return ret;
+}
+
 #ifdef TESTS
 STATIC void number_shift_right(u1024_t *num, int n)
 {
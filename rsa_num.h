@@ -17,19 +17,20 @@ typedef enum {
 	FUNC_NUMBER_FIND_MOST_SIGNIFICANT_SET_BIT,
 	FUNC_NUMBER_ADD,
 	FUNC_NUMBER_SMALL_DEC2NUM,
-	FUNC_NUMBER_2COMPLEMENT,
 	FUNC_NUMBER_SUB,
 	FUNC_NUMBER_MUL,
 	FUNC_NUMBER_MODULAR_MULTIPLICATION_NAIVE,
 	FUNC_NUMBER_MODULAR_MULTIPLICATION_MONTGOMERY,
 	FUNC_NUMBER_ABSOLUTE_VALUE,
 	FUNC_NUMBER_DEV,
+	FUNC_NUMBER_BARRETT_DEV,
 	FUNC_NUMBER_INIT_RANDOM_STRICT_RANGE,
 	FUNC_NUMBER_EXPONENTIATION,
 	FUNC_NUMBER_MODULAR_EXPONENTIATION_NAIVE,
-	FUNC_NUMBER_MONTGOMERY_FACTOR_SET,
+	FUNC_NUMBER_MONTGOMERY_CTX_INIT,
 	FUNC_NUMBER_MONTGOMERY_PRODUCT,
 	FUNC_NUMBER_MODULAR_EXPONENTIATION_MONTGOMERY,
+	FUNC_NUMBER_MODULAR_EXPONENTIATION_CRT,
 	FUNC_NUMBER_WITNESS_INIT,
 	FUNC_NUMBER_WITNESS,
 	FUNC_NUMBER_MILLER_RABIN,
@@ -39,9 +40,10 @@ typedef enum {
 	FUNC_NUMBER_SMALL_PRIME_INIT,
 	FUNC_NUMBER_GENERATE_COPRIME,
 	FUNC_NUMBER_EXTENDED_EUCLID_GCD,
-	FUNC_NUMBER_EUCLID_GCD,
+	FUNC_NUMBER_BINARY_GCD,
 	FUNC_NUMBER_INIT_RANDOM_COPRIME,
 	FUNC_NUMBER_MODULAR_MULTIPLICATIVE_INVERSE,
+	FUNC_NUMBER_SIEVE_INIT,
 	FUNC_NUMBER_FIND_PRIME,
 	FUNC_NUMBER_SHIFT_LEFT,
 	FUNC_NUMBER_SHIFT_RIGHT,
@@ -51,18 +53,24 @@ typedef enum {
 #ifdef TESTS
 #if defined(UCHAR)
 #define U64_TYPE unsigned char
+#define U128_TYPE unsigned short
 #elif defined(USHORT)
 #define U64_TYPE unsigned short
+#define U128_TYPE unsigned int
 #elif defined(UINT)
 #define U64_TYPE unsigned int
+#define U128_TYPE unsigned long long
 #elif defined(ULLONG)
 #define U64_TYPE unsigned long long
+#define U128_TYPE unsigned __int128
 #if !defined(ULLONG)
 #define ULLONG
 #endif
 #endif
 
 typedef U64_TYPE u64;
+/* double width u64, holds the full product of two u64s */
+typedef U128_TYPE u128;
 #define STATIC
 #define INLINE
 
@@ -79,11 +87,13 @@ inline void timer_stop(func_cnt_t func);
 #define TIMER_START(FUNC)
 #define TIMER_STOP(FUNC)
 typedef unsigned long long u64;
+typedef unsigned __int128 u128;
 #define STATIC static
 #define INLINE inline
 #endif /* TESTS */
 
 #ifdef MERSENNE_TWISTER
+#include "mt19937_64.h"
 typedef unsigned long long prng_seed_t;
 #else
 typedef unsigned int prng_seed_t;
@@ -153,11 +163,7 @@ while (0)
 		(num)->top++; \
 } while (0)
 
-#define number_sub1(num) do { \
-	u1024_t __num_1; \
-	number_assign(__num_1, NUM_1); \
-	number_sub((num), (num), &__num_1); \
-} while (0)
+#define number_sub1(num) number_sub((num), (num), &NUM_1)
 
 /* return: num1 > num2 or ret_on_equal if num1 == num2 */
 #define number_compare(num1, num2, ret_on_equal) ({ \
@@ -222,8 +228,8 @@ extern u1024_t NUM_2;
 extern u1024_t NUM_5;
 extern u1024_t NUM_10;
 extern int bit_sz_u64;
-extern int encryption_level;
-extern int block_sz_u1024;
+extern __thread int encryption_level;
+extern __thread int block_sz_u1024;
 extern int encryption_levels[];
 
 typedef struct {
@@ -233,32 +239,141 @@ typedef struct {
 	u1024_t power_of_prime;
 } small_prime_entry_t;
 
+/* montgomery context of an odd modulus, n, at a given encryption level, with
+ * r = 2^encryption_level. set up once per modulus and passed to montgomery
+ * exponentiation */
+typedef struct {
+	u1024_t n;
+	u64 n0inv; /* -n^-1 mod 2^bit_sz_u64 */
+	u1024_t rr; /* r^2 mod n */
+	u1024_t r; /* r mod n, 1 in the n-residue domain */
+} montgomery_ctx_t;
+
+/* chinese remainder theorem private key. p and q are at most half the
+ * encryption level wide and their montgomery factors are set at half the
+ * encryption level. p == 0 marks a key with no crt representation */
+typedef struct {
+	u1024_t p;
+	u1024_t q;
+	u1024_t dp; /* d mod (p-1) */
+	u1024_t dq; /* d mod (q-1) */
+	u1024_t qinv; /* q^-1 mod p */
+	u1024_t factor_p;
+	u1024_t factor_q;
+} crt_key_t;
+
+/* prng state. random(3) has no state of its own to keep, so without
+ * MERSENNE_TWISTER only the seed is kept per state */
+typedef struct {
+	prng_seed_t seed;
+#ifdef MERSENNE_TWISTER
+	mt19937_64_t mt;
+#endif
+} prng_t;
+
+/* barrett context of a modulus, m, of k limbs at a given encryption level, with
+ * mu = 2^(2*k*bit_sz_u64) / m. set up once per modulus and passed to barrett
+ * division */
+typedef struct {
+	u1024_t m;
+	int k;
+	u64 mu[RSA_NUMBER_ARRAY_SZ + 2];
+} barrett_ctx_t;
+
+/* number layer context: an encryption level, a montgomery context and a prng.
+ * the number_ctx_*() functions below cover add, sub, mul, dev, random numbers,
+ * prime search, the inverse and montgomery and crt exponentiation only. each
+ * installs the context as the calling thread's for the duration of the call and
+ * then restores the thread's own level, so contexts at different levels may be
+ * used side by side. all other number_*() functions run in the calling
+ * thread's context, set by number_enclevl_set() and the number_seed_set_*()
+ * functions. with the mersenne twister each context has a prng of its own;
+ * without it all contexts and threads share random(3) */
+typedef struct {
+	int encryption_level;
+	montgomery_ctx_t mont;
+	prng_t prng;
+} number_ctx_t;
+
 int number_enclevl_set(int level);
 int number_data2num(u1024_t *num, void *data, int len);
 int number_size(int level);
+void number_pack(void *packed, u1024_t *num);
+void number_unpack(u1024_t *num, void *packed);
+/* operands are read in place. a result may be any of the operands */
 void number_add(u1024_t *res, u1024_t *num1, u1024_t *num2);
 void number_sub(u1024_t *res, u1024_t *num1, u1024_t *num2);
 void number_mul(u1024_t *res, u1024_t *num1, u1024_t *num2);
 void number_dev(u1024_t *num_q, u1024_t *num_r, u1024_t *num_dividend,
 	u1024_t *num_divisor);
+void number_barrett_ctx_init(barrett_ctx_t *ctx, u1024_t *num_m);
+void number_barrett_dev(u1024_t *num_q, u1024_t *num_r, u1024_t *num_x,
+	barrett_ctx_t *ctx);
+#define number_barrett_mod(r, x, ctx) do { \
+	u1024_t __q; \
+	number_barrett_dev(&__q, (r), (x), (ctx)); \
+} while (0)
 int number_seed_set_random(u1024_t *seed);
 int number_seed_set_fixed(u1024_t *seed);
 int number_init_random(u1024_t *num, int blocks);
 void number_init_random_coprime(u1024_t *num, u1024_t *coprime);
 void number_find_prime(u1024_t *num);
-void number_montgomery_factor_set(u1024_t *num_n, u1024_t *num_factor);
-void number_montgomery_factor_get(u1024_t *num);
+int number_find_prime_race(u1024_t *num, int *cancel);
+void number_sieve_stats_get(unsigned long *hits, unsigned long *misses);
+void number_montgomery_ctx_init(montgomery_ctx_t *ctx, u1024_t *num_n,
+	u1024_t *num_factor);
+void number_montgomery_ctx_factor_get(montgomery_ctx_t *ctx,
+	u1024_t *num_factor);
 int number_modular_multiplicative_inverse(u1024_t *inv, u1024_t *num,
 	u1024_t *mod);
+int number_montgomery_exponentiation(u1024_t *res, u1024_t *a,
+	u1024_t *b, montgomery_ctx_t *ctx);
 int number_modular_exponentiation_montgomery(u1024_t *res, u1024_t *a,
 	u1024_t *b, u1024_t *n);
+/* numbers exponentiated together by the batch functions */
+#define NUMBER_LANES 8
+int number_montgomery_exponentiation_batch(u1024_t **res, u1024_t **a,
+	int num, u1024_t *b, montgomery_ctx_t *ctx);
+int number_crt_key_init(crt_key_t *crt, u1024_t *p, u1024_t *q, u1024_t *d);
+int number_modular_exponentiation_crt(u1024_t *res, u1024_t *a,
+	crt_key_t *crt);
+int number_modular_exponentiation_crt_batch(u1024_t **res, u1024_t **a,
+	int num, crt_key_t *crt);
 int number_str2num(u1024_t *num, char *str);
 void number_small_dec2num(u1024_t *num_n, u64 dec);
+u64 number_random(void);
+/* arithmetic backends, see number_backend_name() */
+char *number_backend_name(int idx, char **desc, int *is_supported);
+int number_backend_set(char *name);
+char *number_backend_get(void);
+
+int number_ctx_init(number_ctx_t *ctx, int level);
+int number_ctx_seed_set(number_ctx_t *ctx, prng_seed_t seed);
+void number_ctx_add(number_ctx_t *ctx, u1024_t *res, u1024_t *num1,
+	u1024_t *num2);
+void number_ctx_sub(number_ctx_t *ctx, u1024_t *res, u1024_t *num1,
+	u1024_t *num2);
+void number_ctx_mul(number_ctx_t *ctx, u1024_t *res, u1024_t *num1,
+	u1024_t *num2);
+void number_ctx_dev(number_ctx_t *ctx, u1024_t *num_q, u1024_t *num_r,
+	u1024_t *num_dividend, u1024_t *num_divisor);
+u64 number_ctx_random(number_ctx_t *ctx);
+int number_ctx_init_random(number_ctx_t *ctx, u1024_t *num, int blocks);
+int number_ctx_find_prime(number_ctx_t *ctx, u1024_t *num, int *cancel);
+int number_ctx_modular_multiplicative_inverse(number_ctx_t *ctx,
+	u1024_t *inv, u1024_t *num, u1024_t *mod);
+void number_ctx_montgomery_set(number_ctx_t *ctx, u1024_t *num_n,
+	u1024_t *num_factor);
+int number_ctx_modular_exponentiation(number_ctx_t *ctx, u1024_t *res,
+	u1024_t *a, u1024_t *b);
+int number_ctx_crt_key_init(number_ctx_t *ctx, crt_key_t *crt, u1024_t *p,
+	u1024_t *q, u1024_t *d);
+int number_ctx_modular_exponentiation_crt(number_ctx_t *ctx, u1024_t *res,
+	u1024_t *a, crt_key_t *crt);
 
 #ifdef TESTS
 extern int init_reset;
-extern u1024_t num_montgomery_n;
-extern prng_seed_t number_random_seed;
+void number_prng_reset(void);
 
 int number_init_str(u1024_t *num, char *init_str);
 void number_shift_left(u1024_t *num, int n);
@@ -283,6 +398,7 @@ void number_exponentiation(u1024_t *res, u1024_t *num_base,
 	u1024_t *num_exp);
 void number_extended_euclid_gcd(u1024_t *gcd, u1024_t *x, u1024_t *a,
 	u1024_t *y, u1024_t *b);
+void number_binary_gcd(u1024_t *gcd, u1024_t *a, u1024_t *b);
 void number_absolute_value(u1024_t *abs, u1024_t *num);
 #endif
 
@@ -241,7 +241,6 @@ func_t func_table[FUNC_COUNT] = {
 	{"number_find_most_significant_set_bit ", 1},
 	[ FUNC_NUMBER_ADD ] = {"number_add", 1},
 	[ FUNC_NUMBER_SMALL_DEC2NUM ] = {"func_number_small_dec2num", 1},
-	[ FUNC_NUMBER_2COMPLEMENT ] = {"number_2complement", 1},
 	[ FUNC_NUMBER_SUB ] = {"number_sub", 1},
 	[ FUNC_NUMBER_MUL ] = {"number_mul", 1},
 	[ FUNC_NUMBER_MODULAR_MULTIPLICATION_NAIVE ] =
@@ -250,16 +249,18 @@ func_t func_table[FUNC_COUNT] = {
 	{"number_modular_multiplication_montgomery", 1},
 	[ FUNC_NUMBER_ABSOLUTE_VALUE ] = {"number_absolute_value", 1},
 	[ FUNC_NUMBER_DEV ] = {"number_dev", 1},
+	[ FUNC_NUMBER_BARRETT_DEV ] = {"number_barrett_dev", 1},
 	[ FUNC_NUMBER_INIT_RANDOM_STRICT_RANGE ] =
 	{"number_init_random_strict_range", 1},
 	[ FUNC_NUMBER_EXPONENTIATION ] = {"number_exponentiation", 1},
 	[ FUNC_NUMBER_MODULAR_EXPONENTIATION_NAIVE ] =
 	{"number_modular_exponentiation_naive", 1},
-	[ FUNC_NUMBER_MONTGOMERY_FACTOR_SET ] = {"number_montgomery_factor_set",
-		1},
+	[ FUNC_NUMBER_MONTGOMERY_CTX_INIT ] = {"number_montgomery_ctx_init", 1},
 	[ FUNC_NUMBER_MONTGOMERY_PRODUCT] = {"number_montgomery_product", 1},
 	[ FUNC_NUMBER_MODULAR_EXPONENTIATION_MONTGOMERY ] =
 	{"number_modular_exponentiation_montgomery", 1},
+	[ FUNC_NUMBER_MODULAR_EXPONENTIATION_CRT ] =
+	{"number_modular_exponentiation_crt", 1},
 	[ FUNC_NUMBER_WITNESS_INIT ] = {"number_witness_init", 1},
 	[ FUNC_NUMBER_WITNESS ] = {"number_witness", 1},
 	[ FUNC_NUMBER_MILLER_RABIN ] = {"number_miller_rabin", 1},
@@ -269,10 +270,11 @@ func_t func_table[FUNC_COUNT] = {
 	[ FUNC_NUMBER_SMALL_PRIME_INIT ] = {"number_small_prime_init", 1},
 	[ FUNC_NUMBER_GENERATE_COPRIME ] = {"number_generate_coprime", 1},
 	[ FUNC_NUMBER_EXTENDED_EUCLID_GCD ] = {"number_extended_euclid_gcd", 1},
-	[ FUNC_NUMBER_EUCLID_GCD ] = {"number_euclid_gcd", 1},
+	[ FUNC_NUMBER_BINARY_GCD ] = {"number_binary_gcd", 1},
 	[ FUNC_NUMBER_INIT_RANDOM_COPRIME ] = {"number_init_random_coprime", 1},
 	[ FUNC_NUMBER_MODULAR_MULTIPLICATIVE_INVERSE ] =
 	{"number_modular_multiplicative_inverse", 1},
+	[ FUNC_NUMBER_SIEVE_INIT ] = {"number_sieve_init", 1},
 	[ FUNC_NUMBER_FIND_PRIME ] = {"number_find_prime", 1},
 	[ FUNC_NUMBER_FIND_PRIME ] = {"number_find_prime", 1},
 };
@@ -1151,6 +1153,32 @@ static int test035(void)
 	return !number_is_equal(&num_a, &res);
 }
 
+static int test036(void)
+{
+	u1024_t num_a, num_b, num_prod, num_q, num_r;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		/* operands of up to half width: the product is not truncated */
+		number_init_random(&num_a, 1 + i % (block_sz_u1024/2));
+		number_init_random(&num_b, block_sz_u1024/2);
+		if (number_is_equal(&num_b, &NUM_0))
+			continue;
+
+		number_mul(&num_prod, &num_a, &num_b);
+		number_dev(&num_q, &num_r, &num_prod, &num_b);
+		if (!number_is_equal(&num_q, &num_a) ||
+			!number_is_equal(&num_r, &NUM_0)) {
+			p_comment_nl("a:");
+			p_u1024(&num_a);
+			p_comment_nl("b:");
+			p_u1024(&num_b);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int test041(void)
 {
 	u1024_t num_547, num_547_again, num_252;
@@ -1384,6 +1412,39 @@ static int test048(void)
 	return ret;
 }
 
+static int test049(void)
+{
+	u1024_t num_a, num_b, num_c;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		/* operands of different lengths, either may be the longer */
+		number_init_random(&num_a, 1 + i % block_sz_u1024);
+		number_init_random(&num_b, 1 + (i / 3) % block_sz_u1024);
+
+		/* (a - b) + b == a, in place */
+		number_sub(&num_c, &num_a, &num_b);
+		number_add(&num_c, &num_c, &num_b);
+		number_reset_buffer(&num_c);
+		if (!number_is_equal(&num_c, &num_a))
+			goto Error;
+
+		/* (a + b) - b == a, in place */
+		number_add(&num_c, &num_a, &num_b);
+		number_sub(&num_c, &num_c, &num_b);
+		if (!number_is_equal(&num_c, &num_a))
+			goto Error;
+	}
+	return 0;
+
+Error:
+	p_comment_nl("a:");
+	p_u1024(&num_a);
+	p_comment_nl("b:");
+	p_u1024(&num_b);
+	return -1;
+}
+
 static int test051(void)
 {
 	u1024_t a, b, q, r, res_q, res_r;
@@ -1574,6 +1635,33 @@ static int test057(void)
 	return 0;
 }
 
+static int test058(void)
+{
+	u1024_t num_a, num_b, num_q, num_r, num_qb;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		/* divisors of every length, including single limb ones */
+		number_init_random(&num_a, block_sz_u1024);
+		number_init_random(&num_b, 1 + i % block_sz_u1024);
+		if (number_is_equal(&num_b, &NUM_0))
+			continue;
+
+		number_dev(&num_q, &num_r, &num_a, &num_b);
+		number_mul(&num_qb, &num_q, &num_b);
+		number_add(&num_qb, &num_qb, &num_r);
+		if (!number_is_equal(&num_qb, &num_a) ||
+			number_is_greater_or_equal(&num_r, &num_b)) {
+			p_comment_nl("a:");
+			p_u1024(&num_a);
+			p_comment_nl("b:");
+			p_u1024(&num_b);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int test061(void)
 {
 	u1024_t a;
@@ -1735,32 +1823,70 @@ static int test069(void)
 static int test071(void)
 {
 	u1024_t num_n, res, num_montgomery_factor;
+	montgomery_ctx_t ctx;
 
 	number_small_dec2num(&num_n, 163);
 	number_small_dec2num(&res, 58);
-	number_montgomery_factor_set(&num_n, NULL);
-	number_montgomery_factor_get(&num_montgomery_factor);
+	number_montgomery_ctx_init(&ctx, &num_n, NULL);
+	number_montgomery_ctx_factor_get(&ctx, &num_montgomery_factor);
 	return !number_is_equal(&num_montgomery_factor, &res);
 }
 
 static int test072(void)
 {
 	u1024_t num_n, num_montgomery_factor;
+	montgomery_ctx_t ctx;
 
 	number_init_random(&num_n, block_sz_u1024);
 	*(u64*)&num_n |= (u64)1;
-	number_montgomery_factor_set(&num_n, NULL);
+	number_montgomery_ctx_init(&ctx, &num_n, NULL);
 	p_comment_nl("n, is a ~%d bit sized random odd number:",
 		encryption_level);
 	p_u1024(&num_n);
 	p_comment_nl("");
 	p_comment_nl("n's montgomery_factor = pow(2, 2^(2*(%d+2))) %% n:",
 		encryption_level);
-	number_montgomery_factor_get(&num_montgomery_factor);
+	number_montgomery_ctx_factor_get(&ctx, &num_montgomery_factor);
 	p_u1024(&num_montgomery_factor);
 	return 0;
 }
 
+static int test073(void)
+{
+	u1024_t num_n, r, rr, factor;
+	montgomery_ctx_t ctx, ctx_factor;
+	int i, j;
+
+	for (i = 0; i < 20; i++) {
+		number_init_random(&num_n, block_sz_u1024 - i % 2);
+		*(u64*)&num_n |= (u64)1;
+
+		/* r = 2^encryption_level mod n and r^2 mod n, bit by bit */
+		number_assign(rr, NUM_1);
+		for (j = 0; j < 2 * encryption_level; j++) {
+			if (j == encryption_level)
+				number_assign(r, rr);
+			number_shift_left_once(&rr);
+			if (number_is_greater_or_equal(&rr, &num_n))
+				number_sub(&rr, &rr, &num_n);
+		}
+
+		/* word level set up vs. set up from the key file factor */
+		number_montgomery_ctx_init(&ctx, &num_n, NULL);
+		number_montgomery_ctx_factor_get(&ctx, &factor);
+		number_montgomery_ctx_init(&ctx_factor, &num_n, &factor);
+		if (!number_is_equal(&ctx.r, &r) ||
+			!number_is_equal(&ctx.rr, &rr) ||
+			!number_is_equal(&ctx_factor.r, &r) ||
+			!number_is_equal(&ctx_factor.rr, &rr)) {
+			p_comment_nl("n:");
+			p_u1024(&num_n);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int test076(void)
 {
 	u1024_t num_4, num_5, num_8, num_9, res;
@@ -1788,6 +1914,36 @@ static int test077(void)
 	return !number_is_equal(&num_45, &res);
 }
 
+static int test078(void)
+{
+	u1024_t num_n, num_a, num_b, res_montgomery, res_naive;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		number_init_random(&num_n, block_sz_u1024/2);
+		*(u64*)&num_n.arr |= (u64)1; /* modulus must be odd */
+		number_init_random(&num_a, block_sz_u1024/2);
+		number_init_random(&num_b, block_sz_u1024/2);
+		number_mod(&num_a, &num_a, &num_n);
+		number_mod(&num_b, &num_b, &num_n);
+
+		number_modular_multiplication_montgomery(&res_montgomery,
+			&num_a, &num_b, &num_n);
+		number_modular_multiplication_naive(&res_naive, &num_a, &num_b,
+			&num_n);
+		if (!number_is_equal(&res_montgomery, &res_naive)) {
+			p_comment_nl("n:");
+			p_u1024(&num_n);
+			p_comment_nl("a:");
+			p_u1024(&num_a);
+			p_comment_nl("b:");
+			p_u1024(&num_b);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int test081(void)
 {
 	u1024_t num_4, num_7, num_5, num_9, res;
@@ -1933,6 +2089,63 @@ static int test087(void)
 	return !number_is_equal(&res, &pow);
 }
 
+static int test088(void)
+{
+	u1024_t num_n, num_a, num_b, res_montgomery, res_naive;
+	int i;
+
+	for (i = 0; i < 20; i++) {
+		number_init_random(&num_n, block_sz_u1024/2);
+		*(u64*)&num_n.arr |= (u64)1; /* modulus must be odd */
+		number_init_random(&num_a, block_sz_u1024/2);
+		number_mod(&num_a, &num_a, &num_n);
+		/* exponents of varying length */
+		number_init_random(&num_b, 1 + i % (block_sz_u1024/2));
+
+		number_modular_exponentiation_montgomery(&res_montgomery,
+			&num_a, &num_b, &num_n);
+		number_modular_exponentiation_naive(&res_naive, &num_a, &num_b,
+			&num_n);
+		if (!number_is_equal(&res_montgomery, &res_naive)) {
+			p_comment_nl("n:");
+			p_u1024(&num_n);
+			p_comment_nl("a:");
+			p_u1024(&num_a);
+			p_comment_nl("b:");
+			p_u1024(&num_b);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int test089(void)
+{
+	u1024_t num_n, num_a, num_b, res_montgomery, res_naive;
+	int i;
+
+	number_small_dec2num(&num_b, (u64)65537);
+	for (i = 0; i < 20; i++) {
+		number_init_random(&num_n, block_sz_u1024/2);
+		*(u64*)&num_n.arr |= (u64)1; /* modulus must be odd */
+		number_init_random(&num_a, block_sz_u1024/2);
+		number_mod(&num_a, &num_a, &num_n);
+
+		number_modular_exponentiation_montgomery(&res_montgomery,
+			&num_a, &num_b, &num_n);
+		number_modular_exponentiation_naive(&res_naive, &num_a, &num_b,
+			&num_n);
+		if (!number_is_equal(&res_montgomery, &res_naive)) {
+			p_comment_nl("n:");
+			p_u1024(&num_n);
+			p_comment_nl("a:");
+			p_u1024(&num_a);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int test091(void)
 {
 	u1024_t a, n;
@@ -2175,6 +2388,461 @@ static int test107(void)
 	return 0;
 }
 
+static int test111(void)
+{
+	u1024_t num_n, num_p, r;
+	unsigned long hits, misses, hits_prev, misses_prev;
+	u64 p;
+	int i, n;
+
+	number_sieve_stats_get(&hits_prev, &misses_prev);
+	for (n = 0; n < 5; n++) {
+		number_find_prime(&num_n);
+		if (!number_is_prime(&num_n))
+			return -1;
+
+		/* no small prime divides num_n */
+		for (p = 3; p < 1000; p += 2) {
+			for (i = 3; i * i <= p && p % i; i += 2);
+			if (i * i <= p)
+				continue;
+			number_small_dec2num(&num_p, p);
+			number_mod(&r, &num_n, &num_p);
+			if (number_is_equal(&r, &NUM_0)) {
+				p_comment_nl("%llu divides:", p);
+				p_u1024(&num_n);
+				return -1;
+			}
+		}
+	}
+	number_sieve_stats_get(&hits, &misses);
+	p_comment_nl("sieve hits: %lu, misses: %lu", hits - hits_prev,
+		misses - misses_prev);
+
+	/* each prime is found on a sieve miss */
+	return misses - misses_prev < 5 || hits == hits_prev;
+}
+
+static int test113(void)
+{
+	u1024_t num_n;
+	int cancel = 0;
+
+	/* a prime found without being cancelled */
+	if (number_find_prime_race(&num_n, &cancel) || !number_is_prime(&num_n))
+		return -1;
+
+	/* another thread has already found the prime sought */
+	cancel = 1;
+	return number_find_prime_race(&num_n, &cancel) != -1;
+}
+
+static int test114_is_equal(u1024_t *num1, u1024_t *num2, int level)
+{
+	return num1->top == num2->top &&
+		!memcmp(num1->arr, num2->arr, level >> 3);
+}
+
+static int test114(void)
+{
+	number_ctx_t ctx_lo, ctx_hi;
+	u1024_t a, b, n, res_lo, res_hi, exp_lo, exp_hi;
+	int level = encryption_level;
+
+	if (!number_ctx_init(&ctx_lo, 100) ||
+		number_ctx_init(&ctx_lo, 128) || number_ctx_init(&ctx_hi, 256))
+		return -1;
+
+	memset(&a, 0, sizeof(u1024_t));
+	memset(&b, 0, sizeof(u1024_t));
+	number_ctx_seed_set(&ctx_lo, 1);
+	number_ctx_seed_set(&ctx_hi, 1);
+	number_ctx_init_random(&ctx_lo, &a, 2);
+	number_ctx_init_random(&ctx_hi, &b, 2);
+#ifdef MERSENNE_TWISTER
+	/* contexts seeded alike draw the same random numbers regardless of
+	 * their level. random(3) is process wide, so this only holds for the
+	 * mersenne twister */
+	if (!test114_is_equal(&a, &b, 128))
+		return -1;
+#endif
+	number_ctx_init_random(&ctx_hi, &n, 4);
+	*(u64*)&n.arr |= 1;
+
+	/* interleaved operations at two levels match those of the thread
+	 * wide api at each level */
+	memset(&res_lo, 0, sizeof(u1024_t));
+	memset(&res_hi, 0, sizeof(u1024_t));
+	memset(&exp_lo, 0, sizeof(u1024_t));
+	memset(&exp_hi, 0, sizeof(u1024_t));
+	number_ctx_mul(&ctx_hi, &res_hi, &a, &b);
+	number_ctx_mul(&ctx_lo, &res_lo, &a, &b);
+	number_enclevl_set(128);
+	number_mul(&exp_lo, &a, &b);
+	number_enclevl_set(256);
+	number_mul(&exp_hi, &a, &b);
+	number_enclevl_set(level);
+	if (!test114_is_equal(&res_lo, &exp_lo, 128) ||
+		!test114_is_equal(&res_hi, &exp_hi, 256)) {
+		return -1;
+	}
+
+	/* (a * b) / b == a */
+	number_ctx_dev(&ctx_hi, &res_lo, &exp_lo, &res_hi, &b);
+	if (!test114_is_equal(&res_lo, &a, 256) ||
+		!number_is_equal(&exp_lo, &NUM_0)) {
+		return -1;
+	}
+
+	number_ctx_montgomery_set(&ctx_hi, &n, NULL);
+	number_ctx_modular_exponentiation(&ctx_hi, &res_hi, &a, &b);
+	number_enclevl_set(256);
+	number_modular_exponentiation_montgomery(&exp_hi, &a, &b, &n);
+	number_enclevl_set(level);
+	if (!test114_is_equal(&res_hi, &exp_hi, 256))
+		return -1;
+
+	/* the thread's own level is left untouched */
+	return encryption_level != level ||
+		block_sz_u1024 != level / bit_sz_u64;
+}
+
+static int test115(void)
+{
+	u1024_t num, res;
+	char packed[sizeof(u1024_t) + 1];
+	int len = (block_sz_u1024 + 1) * sizeof(u64) + sizeof(int);
+
+	/* a number packs into its level's size and unpacks intact */
+	memset(packed, 0xff, sizeof(packed));
+	number_init_random(&num, block_sz_u1024);
+	num.arr[block_sz_u1024] = 1;
+	number_top_set(&num);
+	number_pack(packed, &num);
+	if ((unsigned char)packed[len] != 0xff)
+		return -1;
+
+	number_reset(&res);
+	number_unpack(&res, packed);
+	return !number_is_equal(&num, &res);
+}
+
+static int test121(void)
+{
+	u1024_t a, b, sum, diff, prod, q, r, res, res2;
+
+	/* results written over an operand match those written elsewhere */
+	if (number_init_random(&a, block_sz_u1024/2) ||
+		number_init_random(&b, block_sz_u1024/2)) {
+		return -1;
+	}
+	number_add(&sum, &a, &b);
+	number_sub(&diff, &a, &b);
+	number_mul(&prod, &a, &b);
+	number_dev(&q, &r, &prod, &b);
+
+	number_assign(res, a);
+	number_add(&res, &res, &b);
+	if (!number_is_equal(&res, &sum))
+		return -1;
+	number_assign(res, b);
+	number_sub(&res, &a, &res);
+	if (!number_is_equal(&res, &diff))
+		return -1;
+	number_assign(res, a);
+	number_mul(&res, &res, &b);
+	if (!number_is_equal(&res, &prod))
+		return -1;
+	number_assign(res, b);
+	number_mul(&res, &a, &res);
+	if (!number_is_equal(&res, &prod))
+		return -1;
+	number_assign(res, a);
+	number_mul(&res, &res, &res);
+	number_mul(&res2, &a, &a);
+	if (!number_is_equal(&res, &res2))
+		return -1;
+
+	/* quotient over the dividend, remainder over the divisor */
+	number_assign(res, prod);
+	number_assign(res2, b);
+	number_dev(&res, &res2, &res, &res2);
+	return !number_is_equal(&res, &q) || !number_is_equal(&res2, &r) ||
+		!number_is_equal(&q, &a) || !number_is_equal(&r, &NUM_0);
+}
+
+static int test122(void)
+{
+	u1024_t n, a, b, c, prod, prod2, res, res2;
+	montgomery_ctx_t ctx;
+	char *backend = number_backend_get();
+	int ret;
+
+	/* the kernels chosen at startup agree with the portable ones */
+	if (number_init_random(&n, block_sz_u1024) ||
+		number_init_random(&a, block_sz_u1024 - 1) ||
+		number_init_random(&b, block_sz_u1024) ||
+		number_init_random(&c, block_sz_u1024/2)) {
+		return -1;
+	}
+	n.arr[0] |= 1;
+	n.arr[block_sz_u1024 - 1] |= (u64)1 << (bit_sz_u64 - 1);
+	number_top_set(&n);
+	number_montgomery_ctx_init(&ctx, &n, NULL);
+
+	number_mul(&prod, &c, &c);
+	if (number_montgomery_exponentiation(&res, &a, &b, &ctx))
+		return -1;
+
+	number_backend_set("portable");
+	number_mul(&prod2, &c, &c);
+	ret = number_montgomery_exponentiation(&res2, &a, &b, &ctx);
+	number_backend_set(backend);
+
+	return ret || !number_is_equal(&prod, &prod2) ||
+		!number_is_equal(&res, &res2);
+}
+
+static int test124(void)
+{
+	u1024_t n, a[NUMBER_LANES], b, prod, prod_ref, res[NUMBER_LANES];
+	u1024_t ref[NUMBER_LANES];
+	u1024_t *a_ptr[NUMBER_LANES], *res_ptr[NUMBER_LANES];
+	montgomery_ctx_t ctx;
+	char *backend = number_backend_get(), *name;
+	int i, j, is_supported, ret = -1;
+
+	if (!number_backend_set("no such backend") ||
+		strcmp(number_backend_get(), backend)) {
+		return -1;
+	}
+
+	number_init_random(&n, block_sz_u1024);
+	n.arr[0] |= 1;
+	n.arr[block_sz_u1024 - 1] |= (u64)1 << (bit_sz_u64 - 1);
+	number_top_set(&n);
+	number_init_random(&b, block_sz_u1024);
+	for (i = 0; i < NUMBER_LANES; i++) {
+		number_init_random(&a[i], block_sz_u1024 - 1);
+		a_ptr[i] = &a[i];
+		res_ptr[i] = &res[i];
+	}
+
+	/* every backend the cpu supports agrees with the portable one */
+	number_backend_set("portable");
+	number_montgomery_ctx_init(&ctx, &n, NULL);
+	for (i = 0; i < NUMBER_LANES; i++)
+		number_montgomery_exponentiation(&ref[i], &a[i], &b, &ctx);
+	number_modular_multiplication_montgomery(&prod_ref, &a[0], &a[1], &n);
+	for (i = 0; (name = number_backend_name(i, NULL, &is_supported));
+		i++) {
+		if (number_backend_set(name) != (is_supported ? 0 : -1))
+			goto Exit;
+		if (!is_supported)
+			continue;
+
+		if (strcmp(number_backend_get(), name))
+			goto Exit;
+		number_montgomery_exponentiation_batch(res_ptr, a_ptr,
+			NUMBER_LANES, &b, &ctx);
+		for (j = 0; j < NUMBER_LANES; j++) {
+			if (!number_is_equal(&res[j], &ref[j]))
+				goto Exit;
+		}
+		number_modular_multiplication_montgomery(&prod, &a[0], &a[1],
+			&n);
+		if (!number_is_equal(&prod, &prod_ref))
+			goto Exit;
+	}
+	ret = 0;
+
+Exit:
+	number_backend_set(backend);
+	return ret;
+}
+
+static int test126(void)
+{
+	u1024_t mod, num, inv, gcd, gcd_euclid, x, y, prod;
+	int i, is_odd, ret;
+
+	/* odd moduli of full width and even ones, such as phi, of half width so
+	 * that num * inv can be checked by number_mul() */
+	for (i = 0; i < 200; i++) {
+		is_odd = i & 1;
+		number_init_random(&mod, is_odd ? block_sz_u1024 :
+			block_sz_u1024 / 2);
+		*(u64*)&mod.arr = is_odd ? *(u64*)&mod.arr | (u64)1 :
+			*(u64*)&mod.arr & ~(u64)1;
+		number_top_set(&mod);
+		number_init_random(&num, block_sz_u1024);
+		number_mod(&num, &num, &mod);
+		if (!number_is_greater(&mod, &NUM_1) ||
+			number_is_equal(&num, &NUM_0)) {
+			continue;
+		}
+
+		number_binary_gcd(&gcd, &num, &mod);
+		number_extended_euclid_gcd(&gcd_euclid, &x, &mod, &y, &num);
+		if (!number_is_equal(&gcd, &gcd_euclid))
+			return -1;
+
+		ret = number_modular_multiplicative_inverse(&inv, &num, &mod);
+		if (ret != (number_is_equal(&gcd, &NUM_1) ? 0 : -1))
+			return -1;
+		if (ret)
+			continue;
+
+		if (is_odd) {
+			number_modular_multiplication_montgomery(&prod, &num,
+				&inv, &mod);
+		}
+		else {
+			number_modular_multiplication_naive(&prod, &num, &inv,
+				&mod);
+		}
+		if (!number_is_greater(&mod, &inv) ||
+			!number_is_equal(&prod, &NUM_1)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int test127(void)
+{
+	u1024_t m, x, q, r, q_barrett, r_barrett;
+	barrett_ctx_t ctx;
+	int i, j;
+
+	/* moduli of every length, powers of 2^bit_sz_u64 among them, and
+	 * numbers of up to twice their length and above */
+	for (i = 0; i < 200; i++) {
+		number_init_random(&m, 1 + i % block_sz_u1024);
+		if (!(i % 10)) {
+			number_reset(&m);
+			*((u64*)&m.arr + i % block_sz_u1024) = 1;
+			number_top_set(&m);
+		}
+		if (number_is_equal(&m, &NUM_0))
+			continue;
+		number_barrett_ctx_init(&ctx, &m);
+
+		for (j = 0; j < 10; j++) {
+			number_init_random(&x, 1 + (i + j) % block_sz_u1024);
+			if (j == 9)
+				number_mul(&x, &m, &NUM_2);
+
+			number_dev(&q, &r, &x, &m);
+			number_barrett_dev(&q_barrett, &r_barrett, &x, &ctx);
+			if (!number_is_equal(&q, &q_barrett) ||
+				!number_is_equal(&r, &r_barrett)) {
+				return -1;
+			}
+
+			/* in place */
+			number_barrett_mod(&x, &x, &ctx);
+			if (!number_is_equal(&x, &r))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/* calls per index of the current job, and calls at a level other than the
+ * caller's */
+static int test128_calls[2], test128_level_errs;
+
+static void test128_func(void *arg, int idx)
+{
+	test128_calls[idx]++;
+	if (encryption_level != *(int*)arg)
+		test128_level_errs++;
+}
+
+static int test128(void)
+{
+	rsa_pool_t *pool;
+	int i, level = encryption_level, ret = 0;
+
+	if (!(pool = rsa_pool_create(16)))
+		return -1;
+
+	/* jobs of fewer indices than threads, back to back, leave most of the
+	 * workers to wake up after the job they were woken for is over */
+	memset(test128_calls, 0, sizeof(test128_calls));
+	test128_level_errs = 0;
+	for (i = 1; i <= 100000; i++) {
+		rsa_pool_run(pool, test128_func, &level,
+			ARRAY_SZ(test128_calls));
+		if (test128_calls[0] != i || test128_calls[1] != i ||
+			test128_level_errs) {
+			ret = -1;
+			break;
+		}
+	}
+
+	rsa_pool_destroy(pool);
+	return ret;
+}
+
+/* a pipeline of numbered buffers: the read step numbers them, the compute step
+ * has the pool double each half of a buffer and the write step checks that the
+ * buffers come out doubled and in order */
+#define TEST129_BUFS 2000
+
+typedef struct {
+	rsa_pool_t *pool;
+	int read;
+	int written;
+	int errs;
+} test129_t;
+
+static void test129_read(void *arg, rsa_pipe_buf_t *buf)
+{
+	test129_t *t = (test129_t*)arg;
+	int *data = (int*)buf->data;
+
+	data[0] = data[1] = t->read++;
+	buf->len = 2 * sizeof(int);
+	buf->is_last = t->read == TEST129_BUFS;
+}
+
+static void test129_double(void *arg, int idx)
+{
+	((int*)arg)[idx] *= 2;
+}
+
+static void test129_compute(void *arg, rsa_pipe_buf_t *buf)
+{
+	rsa_pool_run(((test129_t*)arg)->pool, test129_double, buf->data, 2);
+}
+
+static void test129_write(void *arg, rsa_pipe_buf_t *buf)
+{
+	test129_t *t = (test129_t*)arg;
+	int *data = (int*)buf->data;
+
+	if (data[0] != 2 * t->written || data[1] != 2 * t->written)
+		t->errs++;
+	t->written++;
+}
+
+static int test129(void)
+{
+	test129_t t = { 0 };
+	int ret;
+
+	if (!(t.pool = rsa_pool_create(8)))
+		return -1;
+
+	ret = rsa_pipe_run(test129_read, test129_compute, test129_write, &t,
+		2 * sizeof(int));
+	rsa_pool_destroy(t.pool);
+
+	return ret || t.errs || t.written != TEST129_BUFS;
+}
+
 static int rsa_key_generator_do(void)
 {
 	char c = 0;
@@ -2610,6 +3278,79 @@ static int test117(void)
 	return rsa_encryptor_decryptor(&n, &e, &d, NULL, 1);
 }
 
+static int test123(void)
+{
+	u1024_t p1, p2, n, e, d, data[NUMBER_LANES + 3], res[NUMBER_LANES + 3];
+	u1024_t *data_ptr[NUMBER_LANES + 3], *res_ptr[NUMBER_LANES + 3];
+	u1024_t single;
+	montgomery_ctx_t ctx;
+	crt_key_t crt;
+	int i, num = ARRAY_SZ(data), is_crt;
+
+	/* a full batch and a partial one, matching single exponentiations */
+	rsa_key_generator(&p1, &p2, &n, &e, &d, 0);
+	is_crt = !number_crt_key_init(&crt, &p1, &p2, &d);
+	number_montgomery_ctx_init(&ctx, &n, NULL);
+	for (i = 0; i < num; i++) {
+		number_init_random(&data[i], block_sz_u1024);
+		number_mod(&data[i], &data[i], &n);
+		data_ptr[i] = &data[i];
+		res_ptr[i] = &res[i];
+	}
+
+	number_montgomery_exponentiation_batch(res_ptr, data_ptr, num, &d,
+		&ctx);
+	for (i = 0; i < num; i++) {
+		number_montgomery_exponentiation(&single, &data[i], &d, &ctx);
+		if (!number_is_equal(&res[i], &single))
+			return -1;
+	}
+
+	if (!is_crt)
+		return 0;
+
+	/* in place */
+	number_modular_exponentiation_crt_batch(data_ptr, data_ptr, num,
+		&crt);
+	for (i = 0; i < num; i++) {
+		if (!number_is_equal(&data[i], &res[i]))
+			return -1;
+	}
+	return 0;
+}
+
+static int test119(void)
+{
+	u1024_t p1, p2, n, e, d, data, res_crt, res_montgomery;
+	crt_key_t crt;
+	int i;
+
+	rsa_key_generator(&p1, &p2, &n, &e, &d, 0);
+	if (number_crt_key_init(&crt, &p1, &p2, &d)) {
+		p_comment_nl("primes are too wide for crt, skipping...");
+		return 0;
+	}
+
+	for (i = 0; i < 20; i++) {
+		number_init_random(&data, block_sz_u1024);
+		number_mod(&data, &data, &n);
+
+		number_modular_exponentiation_crt(&res_crt, &data, &crt);
+		number_modular_exponentiation_montgomery(&res_montgomery,
+			&data, &d, &n);
+		if (!number_is_equal(&res_crt, &res_montgomery)) {
+			p_comment_nl("n:");
+			p_u1024(&n);
+			p_comment_nl("d:");
+			p_u1024(&d);
+			p_comment_nl("data:");
+			p_u1024(&data);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 static int test118(void)
 {
 #define MULTIPLE_RSA "1000"
@@ -2863,6 +3604,10 @@ static test_t rsa_tests[] = {
 		DISABLE_ULLONG_64 | DISABLE_ULLONG_128 | DISABLE_ULLONG_256 |
 		DISABLE_ULLONG_512,
 	},
+	{
+		description: "number_mul() - random numbers, (a*b)/b == a",
+		func: test036,
+	},
 	/* number subtraction */
 	{
 		description: "number_is_greater() and number_is_equal()",
@@ -2906,6 +3651,10 @@ static test_t rsa_tests[] = {
 		func: test048,
 		disabled: DISABLE_USHORT | DISABLE_UINT | DISABLE_ULLONG,
 	},
+	{
+		description: "number_add() and number_sub() - random numbers",
+		func: test049,
+	},
 	/* number devision */
 	{
 		description: "number_dev() - basic functionality",
@@ -2945,6 +3694,11 @@ static test_t rsa_tests[] = {
 		func: test057,
 		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT,
 	},
+	{
+		description: "number_dev() - random numbers, q*b + r == a, "
+			"r < b",
+		func: test058,
+	},
 	/* finding most significant bit */
 	{
 		description: "number_find_most_significant_set_bit()",
@@ -2992,18 +3746,24 @@ static test_t rsa_tests[] = {
 	},
 	/* setting montgomery factor: 2^(2(encryption_level+2)) */
 	{
-		description: "number_montgomery_factor_set()",
+		description: "number_montgomery_ctx_init()",
 		func: test071,
 		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
 			DISABLE_ULLONG_64 | DISABLE_ULLONG_128 |
 			DISABLE_ULLONG_256 | DISABLE_ULLONG_512,
 	},
 	{
-		description: "number_montgomery_factor_set() - for a random "
+		description: "number_montgomery_ctx_init() - for a random "
 			"number",
 		func: test072,
 		disabled: DISABLE_UCHAR,
 	},
+	{
+		description: "number_montgomery_ctx_init() - word level r^2 "
+			"mod n vs. bit level and key file factor",
+		func: test073,
+		disabled: DISABLE_UCHAR | DISABLE_TIME_FUNCTIONS,
+	},
 	/* montgomery modular multiplication */
 	{
 		description: "number_modular_multiplication_montgomery()",
@@ -3015,6 +3775,12 @@ static test_t rsa_tests[] = {
 		func: test077,
 		disabled: DISABLE_UCHAR,
 	},
+	{
+		description: "number_modular_multiplication_montgomery() - "
+			"random numbers compared with naive",
+		func: test078,
+		disabled: DISABLE_UCHAR,
+	},
 	/* montgomery modular exponentiation */
 	{
 		description: "number_modular_exponentiation_montgomery()",
@@ -3054,6 +3820,18 @@ static test_t rsa_tests[] = {
 		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
 			DISABLE_TIME_FUNCTIONS,
 	},
+	{
+		description: "number_modular_exponentiation_montgomery() - "
+			"random numbers compared with naive",
+		func: test088,
+		disabled: DISABLE_UCHAR | DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "number_modular_exponentiation_montgomery() - "
+			"short exponent (65537) compared with naive",
+		func: test089,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_TIME_FUNCTIONS,
+	},
 	/* prime testing */
 	{
 		description: "number_witness() - basic functionality",
@@ -3137,6 +3915,78 @@ static test_t rsa_tests[] = {
 		func: test107,
 		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT,
 	},
+	{
+		description: "number_find_prime() - incremental sieve",
+		func: test111,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "number_find_prime_race() - cancelled search",
+		func: test113,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "number_ctx_*() - contexts at different levels",
+		func: test114,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_ULLONG_64 | DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "number_pack() / number_unpack()",
+		func: test115,
+		disabled: DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "arithmetic with the result over an operand",
+		func: test121,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "arithmetic kernels - cpu specific and portable",
+		func: test122,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "batched exponentiation",
+		func: test123,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "arithmetic backends - selection and agreement",
+		func: test124,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "number_binary_gcd() / "
+			"number_modular_multiplicative_inverse() - random "
+			"numbers",
+		func: test126,
+		disabled: DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "number_barrett_dev() - random numbers, matching "
+			"number_dev()",
+		func: test127,
+		disabled: DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "rsa_pool_run() - back to back jobs, more threads "
+			"than indices",
+		func: test128,
+		disabled: DISABLE_TIME_FUNCTIONS,
+	},
+	{
+		description: "rsa_pipe_run() - several buffers, computed on a "
+			"pool of threads",
+		func: test129,
+		disabled: DISABLE_TIME_FUNCTIONS,
+	},
 	{
 		description: "encryption - decryption with "
 			"length(n=p1xp2)=1024 bits",
@@ -3190,6 +4040,12 @@ static test_t rsa_tests[] = {
 			DISABLE_ULLONG_512 | DISABLE_ULLONG_1024 |
 			DISABLE_TIME_FUNCTIONS,
 	},
+	{
+		description: "chinese remainder theorem decryption",
+		func: test119,
+		disabled: DISABLE_UCHAR | DISABLE_USHORT | DISABLE_UINT |
+			DISABLE_TIME_FUNCTIONS,
+	},
 	/* symmetric/asymmetric key combination */
 	{
 		description: "complete RSA + symmetric key test - key "
@@ -3242,7 +4098,7 @@ static void rsa_tests_init(int argc, char *argv[])
 static void rsa_pre_test(void)
 {
 	init_reset = 1;
-	number_random_seed = 0;
+	number_prng_reset();
 }
 
 static int rsa_is_disabled(int flags)
@@ -1,8 +1,10 @@
+#include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "rsa_util.h"
 
 #define RSA_TIMELINE_LEN 80
@@ -137,6 +139,29 @@ static void rsa_message(int is_error, rsa_errno_t err, va_list ap)
 		rsa_strcat(msg, "key may cause loss of information, "
 			"regenerating...");
 		break;
+	case RSA_ERR_KEYGEN_F4:
+		rsa_strcat(msg, "a fixed public exponent is applicable only "
+			"when generating keys");
+		break;
+	case RSA_ERR_KEYGEN_THREADS:
+		rsa_strcat(msg, "key generation threads are applicable only "
+			"when generating keys");
+		break;
+	case RSA_ERR_THREADS:
+		rsa_vstrcat(msg, "invalid number of threads - %s (1 to %d)",
+			ap);
+		break;
+	case RSA_ERR_BATCH:
+		rsa_vstrcat(msg, "invalid batch size - %s (a multiple of %d up "
+			"to %d)", ap);
+		break;
+	case RSA_ERR_BACKEND:
+		rsa_vstrcat(msg, "invalid arithmetic backend - %s (see "
+			"--list-backends)", ap);
+		break;
+	case RSA_ERR_CIPHER_MODE:
+		rsa_strcat(msg, "only one cipher mode can be set");
+		break;
 	case RSA_ERR_KEYNOTEXIST:
 		rsa_vstrcat(msg, "key %s does not exist in the key directory",
 			ap);
@@ -358,3 +383,332 @@ void rsa_timeline_uninit(void)
 	fflush(stdout);
 }
 
+/* a pool of threads running jobs alongside the calling thread. a job is a
+ * function called once per index in [0, num), in no particular order, by
+ * whichever thread gets to the index first. jobs run at the calling thread's
+ * encryption level */
+struct rsa_pool_t {
+	pthread_t threads[RSA_THREADS_MAX];
+	int threads_num;
+	pthread_mutex_t lock;
+	pthread_cond_t cond_job;
+	pthread_cond_t cond_done;
+	unsigned long job; /* incremented per job */
+	rsa_pool_func_t func;
+	void *arg;
+	int level;
+	int num;
+	int next; /* next index to run */
+	int busy; /* threads running the current job */
+	int is_exit;
+};
+
+/* run the current job's indices until there are none left */
+static void rsa_pool_job_run(rsa_pool_t *pool)
+{
+	int idx;
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->next < pool->num) {
+		idx = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		pool->func(pool->arg, idx);
+		pthread_mutex_lock(&pool->lock);
+	}
+	if (!--pool->busy)
+		pthread_cond_broadcast(&pool->cond_done);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void *rsa_pool_worker(void *arg)
+{
+	rsa_pool_t *pool = (rsa_pool_t*)arg;
+	unsigned long job = 0;
+	int level;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1) {
+		while (!pool->is_exit && pool->job == job)
+			pthread_cond_wait(&pool->cond_job, &pool->lock);
+		if (pool->is_exit)
+			break;
+
+		/* join the current job only while it has indices left. a job
+		 * that has run out of them may be over, and its count of busy
+		 * threads already down to zero */
+		job = pool->job;
+		if (pool->next >= pool->num)
+			continue;
+		pool->busy++;
+		level = pool->level;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (encryption_level != level)
+			number_enclevl_set(level);
+		rsa_pool_job_run(pool);
+
+		pthread_mutex_lock(&pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/* returns NULL for a single thread, in which case jobs run serially */
+rsa_pool_t *rsa_pool_create(int threads)
+{
+	rsa_pool_t *pool;
+
+	if (threads < 2 || !(pool = calloc(1, sizeof(rsa_pool_t))))
+		return NULL;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond_job, NULL);
+	pthread_cond_init(&pool->cond_done, NULL);
+
+	/* the calling thread is the pool's first thread */
+	for (pool->threads_num = 0; pool->threads_num < threads - 1;
+		pool->threads_num++) {
+		if (pthread_create(&pool->threads[pool->threads_num], NULL,
+			rsa_pool_worker, pool)) {
+			break;
+		}
+	}
+
+	return pool;
+}
+
+void rsa_pool_destroy(rsa_pool_t *pool)
+{
+	int i;
+
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->is_exit = 1;
+	pthread_cond_broadcast(&pool->cond_job);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->threads_num; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_cond_destroy(&pool->cond_done);
+	pthread_cond_destroy(&pool->cond_job);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+/* returns once func has been called for all indices */
+void rsa_pool_run(rsa_pool_t *pool, rsa_pool_func_t func, void *arg, int num)
+{
+	int i;
+
+	if (!pool || num < 2) {
+		for (i = 0; i < num; i++)
+			func(arg, i);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->func = func;
+	pool->arg = arg;
+	pool->level = encryption_level;
+	pool->num = num;
+	pool->next = 0;
+	pool->busy++; /* the calling thread */
+	pool->job++;
+	pthread_cond_broadcast(&pool->cond_job);
+	pthread_mutex_unlock(&pool->lock);
+
+	rsa_pool_job_run(pool);
+
+	/* wait for the workers to finish their last indices */
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy)
+		pthread_cond_wait(&pool->cond_done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* data buffers are cache line aligned, and are kept for reuse once they are
+ * put back */
+#define RSA_BUFS_CACHED 8
+
+static struct {
+	void *data;
+	int size;
+	int is_used;
+} rsa_bufs[RSA_BUFS_CACHED];
+static pthread_mutex_t rsa_bufs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void *rsa_buf_get(int size)
+{
+	void *data = NULL;
+	int i, slot = -1;
+
+	size = (size + RSA_CACHE_LINE - 1) & ~(RSA_CACHE_LINE - 1);
+
+	pthread_mutex_lock(&rsa_bufs_lock);
+	for (i = 0; i < RSA_BUFS_CACHED; i++) {
+		if (rsa_bufs[i].is_used)
+			continue;
+
+		if (rsa_bufs[i].data && rsa_bufs[i].size >= size) {
+			rsa_bufs[i].is_used = 1;
+			data = rsa_bufs[i].data;
+			goto Exit;
+		}
+		if (slot == -1 || rsa_bufs[slot].data)
+			slot = i;
+	}
+
+	if (posix_memalign(&data, RSA_CACHE_LINE, size)) {
+		data = NULL;
+		goto Exit;
+	}
+
+	/* cache the new buffer in place of an empty or a too small one */
+	if (slot != -1) {
+		free(rsa_bufs[slot].data);
+		rsa_bufs[slot].data = data;
+		rsa_bufs[slot].size = size;
+		rsa_bufs[slot].is_used = 1;
+	}
+
+Exit:
+	pthread_mutex_unlock(&rsa_bufs_lock);
+	return data;
+}
+
+void rsa_buf_put(void *buf)
+{
+	int i;
+
+	if (!buf)
+		return;
+
+	pthread_mutex_lock(&rsa_bufs_lock);
+	for (i = 0; i < RSA_BUFS_CACHED && rsa_bufs[i].data != buf; i++);
+	if (i < RSA_BUFS_CACHED)
+		rsa_bufs[i].is_used = 0;
+	else
+		free(buf);
+	pthread_mutex_unlock(&rsa_bufs_lock);
+}
+
+/* a three step pipeline: read, compute and write. a reader thread, the calling
+ * thread and a writer thread each run one step, passing RSA_PIPE_BUFS buffers
+ * round robin, so that file io overlaps computation. each buffer's state is
+ * the next step to run on it. every step handles the buffers in order, up to
+ * and including the one marked is_last by the read step */
+#define RSA_PIPE_BUFS 3
+#define RSA_PIPE_STEPS 3
+
+typedef struct {
+	rsa_pipe_buf_t bufs[RSA_PIPE_BUFS];
+	rsa_pipe_func_t steps[RSA_PIPE_STEPS];
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	void *arg;
+	int level;
+} rsa_pipe_t;
+
+/* a thread running steps first to last */
+typedef struct {
+	rsa_pipe_t *pipe;
+	int first;
+	int last;
+} rsa_pipe_stage_t;
+
+static void *rsa_pipe_stage(void *arg)
+{
+	rsa_pipe_stage_t *stage = (rsa_pipe_stage_t*)arg;
+	rsa_pipe_t *pipe = stage->pipe;
+	rsa_pipe_buf_t *buf;
+	int i = 0, step, is_last;
+
+	if (encryption_level != pipe->level)
+		number_enclevl_set(pipe->level);
+
+	do {
+		buf = &pipe->bufs[i];
+		pthread_mutex_lock(&pipe->lock);
+		while (buf->state != stage->first)
+			pthread_cond_wait(&pipe->cond, &pipe->lock);
+		pthread_mutex_unlock(&pipe->lock);
+
+		for (step = stage->first; step <= stage->last; step++)
+			pipe->steps[step](pipe->arg, buf);
+		is_last = buf->is_last;
+
+		pthread_mutex_lock(&pipe->lock);
+		buf->state = (stage->last + 1) % RSA_PIPE_STEPS;
+		pthread_cond_broadcast(&pipe->cond);
+		pthread_mutex_unlock(&pipe->lock);
+		i = (i + 1) % RSA_PIPE_BUFS;
+	}
+	while (!is_last);
+
+	return NULL;
+}
+
+/* buffers are buf_size bytes long. steps for which a thread can not be created
+ * run on the calling thread. returns -1 if no buffer can be allocated */
+int rsa_pipe_run(rsa_pipe_func_t read, rsa_pipe_func_t compute,
+	rsa_pipe_func_t write, void *arg, int buf_size)
+{
+	rsa_pipe_t pipe = {
+		.steps = { read, compute, write },
+		.arg = arg,
+		.level = encryption_level,
+	};
+	rsa_pipe_stage_t reader = { &pipe, 0, 0 }, writer = { &pipe, 2, 2 };
+	rsa_pipe_stage_t caller = { &pipe, 0, 2 };
+	pthread_t reader_thread, writer_thread;
+	int i, is_reader = 0, is_writer = 0, ret = 0;
+
+	for (i = 0; i < RSA_PIPE_BUFS; i++) {
+		if (!(pipe.bufs[i].data = rsa_buf_get(buf_size)))
+			goto Serial;
+	}
+
+	pthread_mutex_init(&pipe.lock, NULL);
+	pthread_cond_init(&pipe.cond, NULL);
+	if (!pthread_create(&writer_thread, NULL, rsa_pipe_stage, &writer)) {
+		is_writer = 1;
+		caller.last = 1;
+	}
+	if (!pthread_create(&reader_thread, NULL, rsa_pipe_stage, &reader)) {
+		is_reader = 1;
+		caller.first = 1;
+	}
+
+	rsa_pipe_stage(&caller);
+
+	if (is_reader)
+		pthread_join(reader_thread, NULL);
+	if (is_writer)
+		pthread_join(writer_thread, NULL);
+	pthread_cond_destroy(&pipe.cond);
+	pthread_mutex_destroy(&pipe.lock);
+	goto Exit;
+
+Serial:
+	/* short on memory, run the steps one after the other on a single
+	 * buffer */
+	if (!pipe.bufs[0].data) {
+		ret = -1;
+		goto Exit;
+	}
+	do {
+		read(arg, &pipe.bufs[0]);
+		compute(arg, &pipe.bufs[0]);
+		write(arg, &pipe.bufs[0]);
+	}
+	while (!pipe.bufs[0].is_last);
+
+Exit:
+	for (i = 0; i < RSA_PIPE_BUFS; i++)
+		rsa_buf_put(pipe.bufs[i].data);
+	return ret;
+}
@@ -9,6 +9,8 @@
 #define MAX_LINE_LENGTH 128
 #define KEY_DATA_MAX_LEN 16
 #define MAX_HIGHLIGHT_STR 128
+#define RSA_THREADS_MAX 64
+#define RSA_CACHE_LINE 64
 
 #define ARRAY_SZ(arr) (sizeof(arr) / sizeof(arr[0]))
 #define IS_WHITESPACE(c) ((c) == ' ' || (c) == '\t')
@@ -24,11 +26,7 @@
 #endif
 #define C_INDENTATION_FMT "\r\E[%dC%%s"
 
-#ifdef MERSENNE_TWISTER
-#define RSA_RANDOM() (u64)genrand64_int64()
-#else
-#define RSA_RANDOM() (u64)random()
-#endif
+#define RSA_RANDOM() number_random()
 
 typedef struct code2code_t {
 	int code;
@@ -42,6 +40,20 @@ typedef struct code2str_t {
 	int disabled;
 } code2str_t;
 
+typedef struct rsa_pool_t rsa_pool_t;
+typedef void (*rsa_pool_func_t)(void *arg, int idx);
+
+/* a pipeline buffer. the read step sets len and is_last, state is internal to
+ * the pipeline */
+typedef struct {
+	void *data;
+	int len;
+	int is_last;
+	int state;
+} rsa_pipe_buf_t;
+
+typedef void (*rsa_pipe_func_t)(void *arg, rsa_pipe_buf_t *buf);
+
 typedef enum {
 	V_NORMAL = 0,
 	V_QUIET,
@@ -65,6 +77,12 @@ typedef enum {
 	RSA_ERR_KEYPATH,
 	RSA_ERR_KEYNAME,
 	RSA_ERR_KEYGEN,
+	RSA_ERR_KEYGEN_F4,
+	RSA_ERR_KEYGEN_THREADS,
+	RSA_ERR_THREADS,
+	RSA_ERR_BATCH,
+	RSA_ERR_BACKEND,
+	RSA_ERR_CIPHER_MODE,
 	RSA_ERR_KEYNOTEXIST,
 	RSA_ERR_KEYMULTIENTRIES,
 	RSA_ERR_KEY_STAT_PUB_DEF,
@@ -99,5 +117,12 @@ char *rsa_highlight_str(char *fmt, ...);
 int rsa_timeline_init(int len, int write_block_sz);
 void rsa_timeline_update(void);
 void rsa_timeline_uninit(void);
+rsa_pool_t *rsa_pool_create(int threads);
+void rsa_pool_destroy(rsa_pool_t *pool);
+void rsa_pool_run(rsa_pool_t *pool, rsa_pool_func_t func, void *arg, int num);
+int rsa_pipe_run(rsa_pipe_func_t read, rsa_pipe_func_t compute,
+	rsa_pipe_func_t write, void *arg, int buf_size);
+void *rsa_buf_get(int size);
+void rsa_buf_put(void *buf);
 #endif
 